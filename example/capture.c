@@ -0,0 +1,176 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+/**
+ * The size to which the file is preallocated, which holds about 2.5 million
+ * packets.
+ */
+#define CAPTURE_CAPACITY	(64 << 20)
+
+static struct {
+	int fd;
+	uint8_t *map;
+	size_t size;		/**< The bytes written so far. */
+	size_t capacity;	/**< The size of the file and the mapping. */
+	int full;		/**< Whether packets are being dropped. */
+} cap = {-1, NULL, 0, 0, 0};
+
+int capture_open(const char *path)
+{
+	int ret;
+
+	cap.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (cap.fd < 0) {
+		perror("error: cannot create capture file");
+		return -1;
+	}
+
+	/*
+	 * The file is allocated and mapped in full here, so that recording a
+	 * packet on the radio path neither resizes nor remaps it.
+	 */
+	ret = posix_fallocate(cap.fd, 0, CAPTURE_CAPACITY);
+	if (ret != 0) {
+		errno = ret;
+		perror("error: cannot allocate capture file");
+		close(cap.fd);
+		cap.fd = -1;
+		return -1;
+	}
+
+	cap.map = mmap(NULL, CAPTURE_CAPACITY, PROT_READ | PROT_WRITE,
+			MAP_SHARED, cap.fd, 0);
+	if (cap.map == MAP_FAILED) {
+		perror("error: cannot map capture file");
+		close(cap.fd);
+		cap.fd = -1;
+		cap.map = NULL;
+		return -1;
+	}
+	cap.capacity = CAPTURE_CAPACITY;
+	cap.full = 0;
+
+	memcpy(cap.map, CAPTURE_MAGIC, CAPTURE_MAGIC_LEN);
+	cap.size = CAPTURE_MAGIC_LEN;
+
+	return 0;
+}
+
+void capture_write(int direction, const struct lc_rx *rx)
+{
+	struct capture_record *r;
+	struct timespec ts;
+
+	if (cap.map == NULL)
+		return;
+
+	if (cap.size + sizeof(*r) > cap.capacity) {
+		if (!cap.full)
+			fputs("warning: capture file full, packets are "
+					"dropped\n", stderr);
+		cap.full = 1;
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	r = (struct capture_record *)(cap.map + cap.size);
+	r->timestamp = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+	r->direction = (uint8_t)direction;
+	r->rssi = rx->rssi;
+	r->lqi = rx->lqi;
+	r->packet = rx->packet;
+
+	cap.size += sizeof(*r);
+}
+
+void capture_close(void)
+{
+	if (cap.fd < 0)
+		return;
+
+	munmap(cap.map, cap.capacity);
+	if (ftruncate(cap.fd, cap.size) != 0)
+		perror("warning: cannot truncate capture file");
+	close(cap.fd);
+
+	cap.fd = -1;
+	cap.map = NULL;
+	cap.size = cap.capacity = 0;
+}
+
+const struct capture_record *capture_map(const char *path, size_t *n)
+{
+	int fd;
+	struct stat st;
+	uint8_t *map;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		perror("error: cannot open capture file");
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	if ((size_t)st.st_size < CAPTURE_MAGIC_LEN) {
+		fputs("error: not a capture file\n", stderr);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("error: cannot map capture file");
+		return NULL;
+	}
+
+	if (memcmp(map, CAPTURE_MAGIC, CAPTURE_MAGIC_LEN) != 0) {
+		fputs("error: not a capture file\n", stderr);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	*n = (st.st_size - CAPTURE_MAGIC_LEN) / sizeof(struct capture_record);
+
+	return (const struct capture_record *)(map + CAPTURE_MAGIC_LEN);
+}
+
+void capture_unmap(const struct capture_record *records, size_t n)
+{
+	munmap((uint8_t *)records - CAPTURE_MAGIC_LEN,
+			CAPTURE_MAGIC_LEN + n * sizeof(*records));
+}
@@ -0,0 +1,83 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <liblicor.h>
+
+/**
+ * The magic bytes at the beginning of a capture file.
+ */
+#define CAPTURE_MAGIC		"LCCAP1\n"
+#define CAPTURE_MAGIC_LEN	8
+
+/**
+ * A packet in a capture file. The fields are in host byte order and the records
+ * are packed.
+ */
+#pragma pack(push, 1)
+struct capture_record {
+	uint64_t timestamp;	/**< CLOCK_MONOTONIC in ns, only relative. */
+	uint8_t direction;	/**< One of `LC_DIRECTIONS`. */
+	int8_t rssi;		/**< The signal strength in dBm. */
+	uint8_t lqi;		/**< The link quality indicator. */
+	struct lc_packet packet;	/**< The packet as it went on air. */
+};
+#pragma pack(pop)
+
+/**
+ * Creates the capture file `path` and starts writing to it.
+ *
+ * The file is preallocated and memory-mapped in full, so that recording a
+ * packet never waits for the disk. Once it is full, further packets are
+ * dropped.
+ *
+ * \return	Returns 0 on success, -1 otherwise.
+ */
+int capture_open(const char *path);
+
+/**
+ * Records a packet, to be used as `lc_tap`.
+ */
+void capture_write(int direction, const struct lc_rx *rx);
+
+/**
+ * Finishes the capture file.
+ */
+void capture_close(void);
+
+/**
+ * Maps the capture file `path` for reading.
+ *
+ * \param[out]	n	The number of records in the file.
+ *
+ * \return	The records, or NULL on error. Must be released with
+ *		capture_unmap().
+ */
+const struct capture_record *capture_map(const char *path, size_t *n);
+
+void capture_unmap(const struct capture_record *records, size_t n);
+
+#endif	/* CAPTURE_H_ */
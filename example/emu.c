@@ -0,0 +1,224 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "emu.h"
+
+#define FIFO_SIZE	64
+
+enum {
+	REG_FIFO = 0x3F,
+	REG_PATABLE = 0x3E,
+	REG_STATUS = 0x30,
+	MCSM1 = 0x17,
+	PARTNUM = 0x30,
+	VERSION = 0x31,
+	MARCSTATE = 0x35,
+	TXBYTES = 0x3A,
+	RXBYTES = 0x3B,
+	SRES = 0x30,
+	SRX = 0x34,
+	STX = 0x35,
+	SIDLE = 0x36,
+	SWOR = 0x38,
+	SPWD = 0x39,
+	SFRX = 0x3A,
+	SFTX = 0x3B
+};
+
+enum {
+	STATE_IDLE = 0,
+	STATE_RX = 1
+};
+
+void (*emu_on_tx)(const uint8_t *frame, uint8_t n_bytes);
+
+unsigned long emu_frames;
+
+static struct {
+	uint8_t regs[0x2F];
+	uint8_t patable[8];
+	uint8_t patable_idx;
+	uint8_t state;
+	uint8_t tx[FIFO_SIZE];
+	uint8_t n_tx;
+	uint8_t rx[FIFO_SIZE];
+	uint8_t n_rx;
+	uint8_t rx_pos;
+} cc;
+
+static void strobe(uint8_t cmnd)
+{
+	switch (cmnd) {
+	case SRES:
+		emu_init();
+		break;
+	case STX:
+		/* TXOFF_MODE of MCSM1 selects the state after the packet. */
+		cc.state = (cc.regs[MCSM1] & 0x03) == 0x03 ? STATE_RX
+				: STATE_IDLE;
+		if (cc.n_tx > 0) {
+			emu_frames++;
+			if (emu_on_tx != NULL)
+				emu_on_tx(cc.tx, cc.n_tx);
+		}
+		cc.n_tx = 0;
+		break;
+	case SRX:
+	case SWOR:
+		cc.state = STATE_RX;
+		break;
+	case SIDLE:
+	case SPWD:
+		cc.state = STATE_IDLE;
+		break;
+	case SFRX:
+		cc.n_rx = 0;
+		cc.rx_pos = 0;
+		break;
+	case SFTX:
+		cc.n_tx = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static uint8_t status_register(uint8_t addr)
+{
+	switch (addr) {
+	case PARTNUM:
+		return 0x80;
+	case VERSION:
+		return 0x03;
+	case MARCSTATE:
+		return cc.state == STATE_RX ? 0x0D : 0x01;
+	case TXBYTES:
+		return cc.n_tx;
+	case RXBYTES:
+		return cc.n_rx - cc.rx_pos;
+	default:
+		return 0;
+	}
+}
+
+static uint8_t status_byte(void)
+{
+	return (uint8_t)(cc.state << 4)
+			| ((cc.n_rx - cc.rx_pos) > 15 ? 15
+				: (cc.n_rx - cc.rx_pos));
+}
+
+int emu_init(void)
+{
+	memset(&cc, 0, sizeof(cc));
+
+	return 0;
+}
+
+int emu_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	uint8_t *tx, *rx, hdr, addr, in, out;
+	int read, burst;
+	uint8_t i;
+
+	if (n_bytes == 0)
+		return 0;
+
+	tx = tx_buf;
+	rx = rx_buf;
+
+	hdr = tx != NULL ? tx[0] : 0;
+	addr = hdr & 0x3F;
+	read = (hdr & 0x80) != 0;
+	burst = (hdr & 0x40) != 0;
+
+	if (rx != NULL)
+		rx[0] = status_byte();
+
+	if (addr >= REG_STATUS && addr < REG_PATABLE
+			&& (!burst || n_bytes == 1)) {
+		strobe(addr);
+		return 0;
+	}
+
+	for (i = 1; i < n_bytes; i++) {
+		in = tx != NULL ? tx[i] : 0;
+		out = 0;
+
+		if (addr == REG_FIFO) {
+			if (read && cc.rx_pos < cc.n_rx)
+				out = cc.rx[cc.rx_pos++];
+			else if (!read && cc.n_tx < FIFO_SIZE)
+				cc.tx[cc.n_tx++] = in;
+		}
+		else if (addr == REG_PATABLE) {
+			if (read)
+				out = cc.patable[cc.patable_idx];
+			else
+				cc.patable[cc.patable_idx] = in;
+			cc.patable_idx = (cc.patable_idx + 1) % 8;
+		}
+		else if (addr >= REG_STATUS) {
+			out = status_register(addr);
+		}
+		else if (read) {
+			out = cc.regs[addr];
+		}
+		else {
+			cc.regs[addr] = in;
+		}
+
+		if (rx != NULL)
+			rx[i] = out;
+
+		if (burst && addr < REG_STATUS)
+			addr++;
+		if (!burst)
+			break;
+	}
+
+	/* The PATABLE index is reset when CSn goes high. */
+	cc.patable_idx = 0;
+
+	return 0;
+}
+
+void emu_inject(const uint8_t *frame, uint8_t n_bytes, uint8_t rssi,
+		uint8_t lqi)
+{
+	if (cc.rx_pos == cc.n_rx)
+		cc.rx_pos = cc.n_rx = 0;
+
+	if (cc.state != STATE_RX || cc.n_rx + n_bytes + 2 > FIFO_SIZE)
+		return;
+
+	memcpy(cc.rx + cc.n_rx, frame, n_bytes);
+	cc.n_rx += n_bytes;
+	cc.rx[cc.n_rx++] = rssi;
+	cc.rx[cc.n_rx++] = lqi;
+
+	/* The radio returns to IDLE after a packet, as set in MCSM1. */
+	cc.state = STATE_IDLE;
+}
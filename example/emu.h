@@ -0,0 +1,58 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EMU_H_
+#define EMU_H_
+
+#include <stdint.h>
+
+/**
+ * Called by the emulated CC2500 for every frame that it transmits, i.e. with
+ * the contents of the TX FIFO at the time of the STX strobe. The radio is
+ * already in the state that follows the transmission, so frames injected from
+ * here reach the RX FIFO if MCSM1 selects RX after TX.
+ */
+extern void (*emu_on_tx)(const uint8_t *frame, uint8_t n_bytes);
+
+/**
+ * The number of frames the emulated CC2500 has transmitted.
+ */
+extern unsigned long emu_frames;
+
+/**
+ * Resets the emulated CC2500.
+ */
+int emu_init(void);
+
+/**
+ * Performs an SPI transfer with the emulated CC2500, with the semantics of
+ * spi_transfer().
+ */
+int emu_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes);
+
+/**
+ * Places a received frame in the RX FIFO of the emulated CC2500, followed by
+ * the two status bytes with the given RSSI and LQI.
+ */
+void emu_inject(const uint8_t *frame, uint8_t n_bytes, uint8_t rssi,
+		uint8_t lqi);
+
+#endif	/* EMU_H_ */
@@ -0,0 +1,350 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <liblicor.h>
+
+#include "emu.h"
+#include "farm.h"
+
+/*
+ * The commands as they are sent on air.
+ */
+enum {
+	CMND_SET_COLOR = 3,
+	CMND_ON = 5,
+	CMND_OFF = 7
+};
+
+/**
+ * The largest number of sequence numbers that a lamp accepts ahead of the last
+ * one, any other one is taken as seen before.
+ */
+#define SEQ_WINDOW	127
+
+struct lamp {
+	uint8_t loss;		/**< Percentage of frames lost on the link. */
+	uint32_t delay;		/**< Processing delay of a frame, us. */
+	int8_t rssi;		/**< RSSI of the answers of the lamp, dBm. */
+	uint8_t seen;		/**< Whether a frame has been accepted yet. */
+	uint8_t seq;		/**< The last sequence number accepted. */
+	uint64_t busy_until;	/**< End of the processing of the last frame. */
+	uint8_t on;		/**< The state of the latest update. */
+	struct color color;	/**< The color of the latest update. */
+	uint8_t pending;	/**< Whether the latest update is undelivered. */
+	uint64_t sent_at;	/**< When the latest update was first sent. */
+	struct farm_stats stats;
+};
+
+static struct {
+	struct lamp *lamps;
+	unsigned int n_lamps;
+	uint8_t base[9];
+	uint32_t random;	/**< State of the xorshift generator. */
+	uint64_t first;		/**< Start of the first frame, us. */
+	uint64_t air;		/**< End of the last frame, us. */
+	unsigned long frames;	/**< Frames transmitted. */
+	unsigned long strays;	/**< Frames to addresses not in the farm. */
+} farm;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * A xorshift generator, so that a farm behaves the same in every run.
+ */
+static uint32_t next_random(void)
+{
+	farm.random ^= farm.random << 13;
+	farm.random ^= farm.random >> 17;
+	farm.random ^= farm.random << 5;
+
+	return farm.random;
+}
+
+/*
+ * Returns a value between half and one and a half times `mean`.
+ */
+static uint32_t spread(uint32_t mean)
+{
+	return mean / 2 + (uint32_t)((uint64_t)next_random() % (mean + 1));
+}
+
+/*
+ * Lets the frame take its air time and returns when it has been received.
+ */
+static uint64_t on_air(void)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	now = now_us();
+	if (farm.air < now)
+		farm.air = now;
+	if (farm.frames == 0)
+		farm.first = farm.air;
+	farm.air += LC_FRAME_PERIOD_US;
+	farm.frames++;
+
+	ts.tv_sec = farm.air / 1000000;
+	ts.tv_nsec = farm.air % 1000000 * 1000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+			== EINTR)
+		;
+
+	return farm.air;
+}
+
+static struct lamp *find_lamp(const uint8_t addr[9])
+{
+	unsigned int i;
+
+	if (memcmp(addr, farm.base, 7) != 0)
+		return NULL;
+
+	i = (unsigned int)addr[7] << 8 | addr[8];
+	if (i >= farm.n_lamps)
+		return NULL;
+
+	return &farm.lamps[i];
+}
+
+/*
+ * Keeps track of the updates sent to the lamp, no matter whether the frame
+ * reaches it.
+ */
+static void track_update(struct lamp *l, const struct lc_packet *p, uint64_t t)
+{
+	uint8_t on;
+
+	switch (p->command) {
+	case CMND_ON:
+	case CMND_SET_COLOR:
+		on = 1;
+		break;
+	case CMND_OFF:
+		on = 0;
+		break;
+	default:
+		return;
+	}
+
+	if (l->stats.updates > 0 && on == l->on && (!on
+			|| memcmp(&p->color, &l->color, sizeof(l->color)) == 0))
+		return;
+
+	if (l->pending)
+		l->stats.missed++;
+
+	l->on = on;
+	l->color = p->color;
+	l->pending = 1;
+	l->sent_at = t;
+	l->stats.updates++;
+}
+
+static void on_tx(const uint8_t *frame, uint8_t n_bytes)
+{
+	struct lc_packet p;
+	struct lamp *l;
+	uint64_t t;
+	uint8_t ahead;
+
+	t = on_air();
+
+	if (n_bytes != sizeof(p))
+		return;
+	memcpy(&p, frame, sizeof(p));
+
+	l = find_lamp(p.address);
+	if (l == NULL) {
+		farm.strays++;
+		return;
+	}
+
+	l->stats.frames++;
+	track_update(l, &p, t - LC_FRAME_PERIOD_US);
+
+	if (next_random() % 100 < l->loss) {
+		l->stats.lost++;
+		return;
+	}
+
+	if (t < l->busy_until) {
+		l->stats.busy++;
+		return;
+	}
+
+	ahead = (uint8_t)(p.sequence_number - l->seq);
+	if (l->seen && (ahead == 0 || ahead > SEQ_WINDOW)) {
+		l->stats.stale++;
+		return;
+	}
+
+	l->seen = 1;
+	l->seq = p.sequence_number;
+	l->busy_until = t + l->delay;
+
+	if (l->pending) {
+		l->pending = 0;
+		l->stats.delivered++;
+		t = l->busy_until - l->sent_at;
+		l->stats.latency += t;
+		if (t > l->stats.latency_max)
+			l->stats.latency_max = (uint32_t)t;
+	}
+
+	/* the answer crosses the same link, the RSSI offset is 72 dB */
+	if (next_random() % 100 >= l->loss)
+		emu_inject(frame, n_bytes, (uint8_t)((l->rssi + 72) * 2),
+				0x80 | l->loss / 2);
+}
+
+int farm_init(const char *spec, const uint8_t base[9])
+{
+	unsigned int n, loss, delay, i;
+	struct lamp *l;
+	int ret;
+
+	loss = 0;
+	delay = 0;
+	ret = sscanf(spec, "%u,%u,%u", &n, &loss, &delay);
+	if (ret < 1 || n == 0 || n > FARM_MAX_LAMPS || loss > 100) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	farm_close();
+
+	farm.lamps = calloc(n, sizeof(*farm.lamps));
+	if (farm.lamps == NULL)
+		return -1;
+
+	farm.n_lamps = n;
+	memcpy(farm.base, base, sizeof(farm.base));
+	farm.random = 2463534242u;
+
+	for (i = 0; i < n; i++) {
+		l = &farm.lamps[i];
+		l->loss = (uint8_t)spread(loss);
+		if (l->loss > 100)
+			l->loss = 100;
+		l->delay = spread(delay);
+		/* from -40 dBm on a perfect link down to -100 dBm */
+		l->rssi = (int8_t)(-40 - l->loss * 6 / 10);
+	}
+
+	emu_on_tx = on_tx;
+
+	return 0;
+}
+
+unsigned int farm_n_lamps(void)
+{
+	return farm.n_lamps;
+}
+
+void farm_address(unsigned int i, uint8_t addr[9])
+{
+	memcpy(addr, farm.base, 7);
+	addr[7] = (uint8_t)(i >> 8);
+	addr[8] = (uint8_t)i;
+}
+
+void farm_report(FILE *f, int verbose)
+{
+	struct farm_stats sum;
+	const struct farm_stats *s;
+	struct lamp *l;
+	unsigned int i;
+	uint64_t t;
+
+	if (farm.lamps == NULL)
+		return;
+
+	memset(&sum, 0, sizeof(sum));
+
+	if (verbose)
+		fputs("lamp  loss  delay  frames  lost  busy stale  updates "
+				"delivered missed  latency   max\n", f);
+
+	for (i = 0; i < farm.n_lamps; i++) {
+		l = &farm.lamps[i];
+		s = &l->stats;
+
+		if (verbose)
+			fprintf(f, "%4u %4hhu%% %6" PRIu32 " %7lu %5lu %5lu "
+					"%5lu %8lu %9lu %6lu %8" PRIu64 " %5"
+					PRIu32 "\n", i, l->loss, l->delay,
+					s->frames, s->lost, s->busy, s->stale,
+					s->updates, s->delivered,
+					s->missed + l->pending,
+					s->delivered > 0 ? s->latency
+						/ s->delivered : 0,
+					s->latency_max);
+
+		sum.frames += s->frames;
+		sum.lost += s->lost;
+		sum.busy += s->busy;
+		sum.stale += s->stale;
+		sum.updates += s->updates;
+		sum.delivered += s->delivered;
+		sum.missed += s->missed + l->pending;
+		sum.latency += s->latency;
+		if (s->latency_max > sum.latency_max)
+			sum.latency_max = s->latency_max;
+	}
+
+	t = farm.air - farm.first;
+	fprintf(f, "%u lamps, %lu frames (%lu lost, %lu while busy, %lu "
+			"stale, %lu to other addresses)\n", farm.n_lamps,
+			farm.frames, sum.lost, sum.busy, sum.stale,
+			farm.strays);
+	fprintf(f, "%lu updates, %lu delivered, %lu missed, latency %" PRIu64
+			" us mean, %" PRIu32 " us max\n", sum.updates,
+			sum.delivered, sum.missed, sum.delivered > 0
+				? sum.latency / sum.delivered : 0,
+			sum.latency_max);
+	if (t > 0)
+		fprintf(f, "%.1f frames/s, %.1f updates delivered/s over %"
+				PRIu64 " ms\n", farm.frames * 1e6 / t,
+				sum.delivered * 1e6 / t, t / 1000);
+}
+
+void farm_close(void)
+{
+	free(farm.lamps);
+	memset(&farm, 0, sizeof(farm));
+	if (emu_on_tx == on_tx)
+		emu_on_tx = NULL;
+}
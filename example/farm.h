@@ -0,0 +1,96 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FARM_H_
+#define FARM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The most lamps a farm can have, as their index is encoded in the last two
+ * bytes of the address.
+ */
+#define FARM_MAX_LAMPS	65536
+
+/**
+ * What happened to the frames of a virtual lamp and to the updates they were
+ * carrying.
+ *
+ * An update is a change of the state or the color that has been sent to the
+ * lamp; its repetitions are frames of the same update. An update is delivered
+ * once the lamp has processed a frame carrying it, and missed if a newer one
+ * comes along before that or if it is never delivered at all.
+ */
+struct farm_stats {
+	unsigned long frames;	/**< Frames addressed to the lamp. */
+	unsigned long lost;	/**< Frames lost on the link. */
+	unsigned long busy;	/**< Frames arriving while still processing. */
+	unsigned long stale;	/**< Frames with a sequence number seen before. */
+	unsigned long updates;	/**< Distinct updates sent. */
+	unsigned long delivered; /**< Updates the lamp has processed. */
+	unsigned long missed;	/**< Updates superseded or never processed. */
+	uint64_t latency;	/**< Sum of the delivery latencies, us. */
+	uint32_t latency_max;	/**< The largest delivery latency, us. */
+};
+
+/**
+ * Populates the farm of virtual lamps behind the emulated CC2500, as specified
+ * by `spec`:
+ *
+ *	N[,LOSS[,DELAY]]
+ *
+ * i.e. the number of lamps, the mean percentage of frames lost on their links
+ * and their mean processing delay in microseconds. Each lamp draws its own loss
+ * and delay between half and one and a half times the mean. Lamp `i` has the
+ * address `base` with `i` in its last two bytes.
+ *
+ * The farm takes over `emu_on_tx`. Each transmission blocks until the frame
+ * would have been on air for LC_FRAME_PERIOD_US after the previous one, so
+ * that the timing of the caller is exercised as with a real radio, and the
+ * latencies and the throughput are those the frames would see on air.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set.
+ */
+int farm_init(const char *spec, const uint8_t base[9]);
+
+/**
+ * Returns the number of lamps of the farm.
+ */
+unsigned int farm_n_lamps(void);
+
+/**
+ * Stores the address of lamp `i` in `addr`.
+ */
+void farm_address(unsigned int i, uint8_t addr[9]);
+
+/**
+ * Prints the aggregate statistics of the farm to `f`, preceded by a line per
+ * lamp if `verbose` is set.
+ */
+void farm_report(FILE *f, int verbose);
+
+/**
+ * Releases the farm.
+ */
+void farm_close(void);
+
+#endif	/* FARM_H_ */
@@ -0,0 +1,41 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef GPIO_H_
+#define GPIO_H_
+
+/**
+ * Requests `line` of the GPIO chip `chip`, e.g. `/dev/gpiochip0`, as an input
+ * that reports falling edges.
+ *
+ * \return	The file descriptor of the line, or -1 on error.
+ */
+int gpio_request_edge(const char *chip, unsigned int line);
+
+/**
+ * Waits up to `timeout_ms` for a falling edge on a line requested with
+ * gpio_request_edge(), a negative timeout waits indefinitely.
+ *
+ * \return	1 if there has been an edge, 0 on timeout, -1 on error.
+ */
+int gpio_wait_edge(int fd, int timeout_ms);
+
+#endif	/* GPIO_H_ */
@@ -27,15 +27,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <unistd.h>
 
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
 #include <linux/spi/spidev.h>
 
 #include <liblicor.h>
 
+#include "capture.h"
+#include "emu.h"
+#include "farm.h"
+#include "gpio.h"
+#include "ring.h"
+#include "rt.h"
+#include "softspi.h"
+#include "ws.h"
+
 #define STS_BASE_DIR	"/var/local/licor"
 #define STS_SEQNO	"seqno"
 
@@ -46,16 +63,49 @@ static struct {
 	struct lc_lamp lamp;
 	int verbose;
 	struct color color;
+	uint16_t width;
+	uint16_t height;
+	char *input;
+	struct color from;
+	uint32_t duration;
+	char *scene;
+	uint8_t state;
+	int timestamps;
+	char *www;
+	uint16_t port;
+	char *capture;
+	double speed;
+	uint8_t first;
+	unsigned int n_channels;
+	uint32_t confirm;
+	uint32_t sync;
+	int priority;
+	int cpu;
+	unsigned int n_samples;
+	unsigned int rounds;
+	char *ring;
+	char *gdo_chip;
+	unsigned int gdo_line;
+	uint8_t seconds;
+	int repair;
 } options = {-1, "/dev/spidev0.0", 1,
 	{
 		{0xF0, 0x58, 0xAD, 0x15, 0xE6, 0x47, 0xA5, 0x0B, 0x11},
 		0
-	}
+	},
+	.www = "/srv/http",
+	.port = 8080,
+	.speed = 1,
+	.n_channels = 256,
+	.cpu = -1,
+	.n_samples = 1000,
+	.rounds = 10,
+	.seconds = 10
 };
 
 static int spi;
 
-int spi_init(void)
+static int spidev_init(void)
 {
 	int ret;
 	uint8_t mode, bits;
@@ -73,108 +123,1990 @@ int spi_init(void)
 		return -1;
 	}
 
-	ret = ioctl(spi, SPI_IOC_WR_MODE, &mode);
-	ret |= ioctl(spi, SPI_IOC_WR_BITS_PER_WORD, &bits);
-	ret |= ioctl(spi, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
-	if (ret != 0) {
-		perror("Trying to configure spidev");
-		return -1;
+	ret = ioctl(spi, SPI_IOC_WR_MODE, &mode);
+	ret |= ioctl(spi, SPI_IOC_WR_BITS_PER_WORD, &bits);
+	ret |= ioctl(spi, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+	if (ret != 0) {
+		perror("Trying to configure spidev");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int spidev_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	int ret;
+	struct spi_ioc_transfer tr = {0};
+
+	if (options.verbose) {
+		if (tx_buf != NULL) {
+			puts("tx_buf:");
+			for (ret = 0; ret < n_bytes; ret++) {
+				printf("%#02hhx ", ((uint8_t *)tx_buf)[ret]);
+				if (ret % 26 == 0)
+					puts("\n");
+			}
+			puts("\n");
+		}
+		if (rx_buf != NULL) {
+			puts("rx_buf:");
+			for (ret = 0; ret < n_bytes; ret++) {
+				printf("%#02hhx ", ((uint8_t *)rx_buf)[ret]);
+				if (ret % 26 == 0)
+					puts("\n");
+			}
+			puts("\n");
+		}
+	}
+
+	tr.tx_buf = (unsigned long)tx_buf;
+	tr.rx_buf = (unsigned long)rx_buf;
+	tr.len = n_bytes;
+	tr.delay_usecs = 100;
+	tr.speed_hz = 5000000;
+	tr.bits_per_word = 8;
+	tr.cs_change = 0;
+
+	ret = ioctl(spi, SPI_IOC_MESSAGE(1), &tr);
+	if (ret < 1) {
+		perror("can't send spi message");
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*
+ * The SPI header byte of the STX strobe.
+ */
+#define SPI_STX		0x35
+
+/*
+ * If set, the time of every STX strobe is stored here, see run_latency().
+ */
+static uint64_t *stx_ns;
+
+/*
+ * The device `emu` selects the emulated CC2500 instead of a spidev device.
+ */
+static int is_emu(void)
+{
+	return strcmp(options.device, "emu") == 0;
+}
+
+/*
+ * A device `farm:SPEC` selects the emulated CC2500 with a farm of virtual lamps
+ * around it, see farm_init().
+ */
+static int is_farm(void)
+{
+	return strncmp(options.device, "farm:", 5) == 0;
+}
+
+/*
+ * A device `gpio:SPEC` selects the soft SPI, see softspi_init().
+ */
+static int is_gpio(void)
+{
+	return strncmp(options.device, "gpio:", 5) == 0;
+}
+
+int spi_init(void)
+{
+	if (is_emu())
+		return emu_init();
+
+	if (is_farm()) {
+		if (farm_init(options.device + 5, options.lamp.addr) == 0)
+			return emu_init();
+		fputs("Trying to set up the lamp farm `", stderr);
+		fputs(options.device + 5, stderr);
+		perror("`");
+		return -1;
+	}
+
+	if (is_gpio()) {
+		if (softspi_init(options.device + 5) == 0)
+			return 0;
+		fputs("Trying to set up the soft SPI `", stderr);
+		fputs(options.device + 5, stderr);
+		perror("`");
+		return -1;
+	}
+
+	return spidev_init();
+}
+
+int spi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	int ret;
+
+	if (is_emu() || is_farm())
+		ret = emu_transfer(tx_buf, rx_buf, n_bytes);
+	else if (is_gpio())
+		ret = softspi_transfer(tx_buf, rx_buf, n_bytes);
+	else
+		ret = spidev_transfer(tx_buf, rx_buf, n_bytes);
+
+	if (stx_ns != NULL && n_bytes == 1 && tx_buf != NULL
+			&& *(uint8_t *)tx_buf == SPI_STX)
+		*stx_ns = now_ns();
+
+	return ret;
+}
+
+/*
+ * The lamp behind the emulated CC2500 answers every frame by sending it back,
+ * which is heard if the radio is in RX after the transmission.
+ */
+static void emu_answer(const uint8_t *frame, uint8_t n_bytes)
+{
+	emu_inject(frame, n_bytes, 0xE0, 0x80 | 0x10);
+}
+
+enum COMMANDS {
+	C_ON = 0, C_OFF = 1, C_SET = 2, C_SCAN = 3, C_AMBIENT = 4,
+	C_FADE = 5, C_SCENE = 6, C_SAVE = 7,
+	C_BATCH = 8, C_SERVE = 9, C_REPLAY = 10,
+	C_SWEEP = 11, C_LATENCY = 12, C_VERIFY = 13, C_BENCH = 14,
+	C_FARM = 15, C_PUSH = 16
+};
+
+static int parse_address(const char *s, uint8_t addr[9])
+{
+	int ret;
+
+	ret = sscanf(s, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+			&addr[0], &addr[1], &addr[2], &addr[3], &addr[4],
+			&addr[5], &addr[6], &addr[7], &addr[8]);
+	if (ret == 9)
+		return 0;
+
+	return -1;
+}
+
+static int parse_command(const char *cmnd)
+{
+	if (strncmp(cmnd, "on", 2) == 0) {
+		return C_ON;
+	}
+	else if (strncmp(cmnd, "off", 3) == 0) {
+		return C_OFF;
+	}
+	else if (strncmp(cmnd, "set", 3) == 0) {
+		return C_SET;
+	}
+	else if (strncmp(cmnd, "scan", 4) == 0) {
+		return C_SCAN;
+	}
+	else if (strncmp(cmnd, "ambient", 7) == 0) {
+		return C_AMBIENT;
+	}
+	else if (strncmp(cmnd, "fade", 4) == 0) {
+		return C_FADE;
+	}
+	else if (strncmp(cmnd, "scene", 5) == 0) {
+		return C_SCENE;
+	}
+	else if (strncmp(cmnd, "save", 4) == 0) {
+		return C_SAVE;
+	}
+	else if (strncmp(cmnd, "batch", 5) == 0) {
+		return C_BATCH;
+	}
+	else if (strncmp(cmnd, "serve", 5) == 0) {
+		return C_SERVE;
+	}
+	else if (strncmp(cmnd, "replay", 6) == 0) {
+		return C_REPLAY;
+	}
+	else if (strncmp(cmnd, "sweep", 5) == 0) {
+		return C_SWEEP;
+	}
+	else if (strncmp(cmnd, "latency", 7) == 0) {
+		return C_LATENCY;
+	}
+	else if (strncmp(cmnd, "verify", 6) == 0) {
+		return C_VERIFY;
+	}
+	else if (strncmp(cmnd, "bench", 5) == 0) {
+		return C_BENCH;
+	}
+	else if (strncmp(cmnd, "farm", 4) == 0) {
+		return C_FARM;
+	}
+	else if (strncmp(cmnd, "push", 4) == 0) {
+		return C_PUSH;
+	}
+	else {
+		return -1;
+	}
+}
+
+static int parse_color(char *s, struct color *c)
+{
+	int ret;
+
+	ret = sscanf(s, "%hhu,%hhu,%hhu",
+			&(c->hue),
+			&(c->saturation),
+			&(c->value));
+	if (ret == 3)
+		return 0;
+
+	return -1;
+}
+
+static int parse_geometry(const char *s, uint16_t *w, uint16_t *h)
+{
+	int ret;
+
+	ret = sscanf(s, "%hux%hu", w, h);
+	if (ret == 2 && *w > 0 && *h > 0)
+		return 0;
+
+	return -1;
+}
+
+static void sleep_until(uint64_t at)
+{
+	struct timespec ts;
+
+	ts.tv_sec = at / 1000000000;
+	ts.tv_nsec = at % 1000000000;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/*
+ * Returns how often a command to the lamp of h goes on air: as given by -r,
+ * or as estimated from the lamp's link if -r is 0.
+ */
+static uint8_t repetitions(const struct lc_handle *h)
+{
+	return options.repetitions ? options.repetitions
+			: lc_handle_repetitions(h);
+}
+
+static uint32_t clock_us(void)
+{
+	return (uint32_t)(now_ns() / 1000);
+}
+
+/*
+ * Repeats the last frame of h until it went on air repetitions(h) times. In
+ * adaptive mode the repetitions of a weak link are spaced out so that they
+ * do not all fall into the same fade.
+ */
+static void repeat(struct lc_handle *h)
+{
+	unsigned int i, n;
+
+	n = repetitions(h);
+	for (i = 1; i < n; i++) {
+		if (options.repetitions == 0 && lc_handle_spacing(h) > 0)
+			sleep_until(now_ns()
+					+ (uint64_t)lc_handle_spacing(h) * 1000);
+		lc_handle_repeat(h);
+	}
+}
+
+/*
+ * Picks up the sequence numbers that the original remote uses for the lamps of
+ * the handles, if -y is given.
+ */
+static void sync_lamps(struct lc_handle *handles, unsigned int n_handles)
+{
+	int n;
+
+	if (options.sync == 0)
+		return;
+
+	n = lc_sync(handles, n_handles, options.sync * 1000);
+	if (n < 0) {
+		perror("warning: cannot sync sequence numbers");
+		return;
+	}
+
+	if (options.verbose)
+		printf("%d packets of the original remote heard\n", n);
+}
+
+/*
+ * Makes sure that the command just sent through h reaches the lamp: by waiting
+ * for its answer and repeating the command only if there is none when -C is
+ * given, by blindly repeating it otherwise.
+ */
+static void deliver(struct lc_handle *h)
+{
+	struct lc_delivery d;
+
+	if (options.confirm == 0) {
+		repeat(h);
+		return;
+	}
+
+	if (lc_handle_confirm(h, repetitions(h), &d) < 0) {
+		perror("error: cannot confirm delivery");
+		return;
+	}
+
+	if (d.delivered)
+		printf("delivered after %hhu frames, round trip %" PRIu32
+				" us\n", d.attempts, d.rtt);
+	else
+		printf("not confirmed after %hhu frames\n", d.attempts);
+}
+
+/*
+ * Feeds raw RGB24 frames from the input file, or from stdin, to an ambient
+ * light pipeline that drives the lamp of `handle` with the average color of
+ * the whole frame.
+ */
+static int run_ambient(struct lc_handle *handle)
+{
+	FILE *in;
+	uint8_t *frame;
+	size_t size;
+	struct lc_ambient ambient;
+	struct lc_ambient_lamp lamp = {0};
+	uint64_t start, t0, t, lat_sum, lat_max, n_frames, n_sent;
+
+	in = stdin;
+	if (options.input != NULL) {
+		in = fopen(options.input, "rb");
+		if (in == NULL) {
+			perror("error: cannot open input");
+			return -1;
+		}
+	}
+
+	size = 3u * options.width * options.height;
+	frame = malloc(size);
+	if (frame == NULL) {
+		perror("error: cannot allocate frame buffer");
+		if (in != stdin)
+			fclose(in);
+		return -1;
+	}
+
+	lamp.handle = handle;
+	lc_ambient_init(&ambient, &lamp, 1, options.width, options.height);
+	ambient.step = options.width / 64 > 0 ? options.width / 64 : 1;
+
+	lat_sum = lat_max = n_frames = n_sent = 0;
+	start = now_ns();
+
+	while (fread(frame, size, 1, in) == 1) {
+		t0 = now_ns();
+		n_sent += lc_ambient_feed(&ambient, frame);
+		t = now_ns() - t0;
+
+		lat_sum += t;
+		if (t > lat_max)
+			lat_max = t;
+		n_frames++;
+
+		if (options.verbose)
+			printf("frame %" PRIu64 ": %u,%u,%u after %" PRIu64
+					" us\n", n_frames,
+					handle->packet.color.hue,
+					handle->packet.color.saturation,
+					handle->packet.color.value, t / 1000);
+	}
+
+	t = now_ns() - start;
+
+	if (n_frames > 0)
+		printf("%" PRIu64 " frames in %" PRIu64 " ms (%.1f fps), "
+				"%" PRIu64 " sent on air\n"
+				"ingest to air: avg %" PRIu64 " us, max %" PRIu64
+				" us\n",
+				n_frames, t / 1000000,
+				n_frames * 1e9 / (t > 0 ? t : 1), n_sent,
+				lat_sum / n_frames / 1000, lat_max / 1000);
+
+	free(frame);
+	if (in != stdin)
+		fclose(in);
+
+	return 0;
+}
+
+/*
+ * Fades the lamp of `handle` from options.from to options.color. The steps are
+ * scheduled by a timerfd, expirations that were missed because the radio or the
+ * scheduler could not keep up are dropped.
+ */
+static int run_fade(struct lc_handle *handle)
+{
+	int tfd, ret;
+	struct lc_transition t;
+	struct itimerspec its = {{0}};
+	uint64_t start, deadline, now, late, late_sum, late_max, exp;
+	uint64_t n_steps, n_missed;
+	uint32_t interval;
+
+	interval = lc_transition_interval(1);
+
+	tfd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (tfd < 0) {
+		perror("error: cannot create timer");
+		return -1;
+	}
+
+	its.it_value.tv_nsec = 1;
+	its.it_interval.tv_sec = interval / 1000000;
+	its.it_interval.tv_nsec = (interval % 1000000) * 1000;
+
+	start = now_ns();
+	ret = timerfd_settime(tfd, 0, &its, NULL);
+	if (ret != 0) {
+		perror("error: cannot arm timer");
+		close(tfd);
+		return -1;
+	}
+
+	lc_transition_start(&t, handle, &options.from, &options.color, 0,
+			options.duration);
+
+	deadline = start;
+	late_sum = late_max = n_steps = n_missed = 0;
+
+	do {
+		if (read(tfd, &exp, sizeof exp) != sizeof exp) {
+			perror("error: cannot read timer");
+			ret = -1;
+			break;
+		}
+
+		now = now_ns();
+		n_missed += exp - 1;
+		deadline += (exp - 1) * interval * 1000;
+
+		late = now > deadline ? now - deadline : 0;
+		late_sum += late;
+		if (late > late_max)
+			late_max = late;
+		n_steps++;
+
+		deadline += (uint64_t)interval * 1000;
+
+		ret = lc_transition_step(&t, (uint32_t)((now - start)
+				/ 1000000));
+	} while (ret > 0);
+
+	close(tfd);
+
+	/* the timer may have failed before the first step */
+	if (n_steps > 0)
+		printf("%" PRIu64 " steps every %" PRIu32 " us, %" PRIu64
+				" missed\njitter: avg %" PRIu64 " us, max %"
+				PRIu64 " us\n", n_steps, interval, n_missed,
+				late_sum / n_steps / 1000, late_max / 1000);
+
+	return ret < 0 ? -1 : 0;
+}
+
+/*
+ * Activates the scene options.scene from the scene store options.input, which
+ * is memory-mapped instead of being parsed.
+ */
+static int run_scene(void)
+{
+	int fd;
+	struct stat st;
+	void *store;
+	const struct lc_scene *scene;
+	struct lc_handle *handles;
+	struct lc_lamp lamp;
+	unsigned int i, sent;
+	uint64_t t;
+
+	fd = open(options.input, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		perror("error: cannot open scene store");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	store = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (store == MAP_FAILED) {
+		perror("error: cannot map scene store");
+		return -1;
+	}
+
+	scene = lc_scene_find(store, st.st_size, options.scene);
+	if (scene == NULL) {
+		fprintf(stderr, "error: no scene `%s`\n", options.scene);
+		munmap(store, st.st_size);
+		return -1;
+	}
+
+	handles = calloc(scene->n_entries, sizeof(*handles));
+	if (handles == NULL) {
+		perror("error: cannot allocate handles");
+		munmap(store, st.st_size);
+		return -1;
+	}
+
+	lamp.seq = options.lamp.seq;
+	for (i = 0; i < scene->n_entries; i++) {
+		memcpy(lamp.addr, scene->entry[i].addr, sizeof(lamp.addr));
+		lc_handle_init(&handles[i], &lamp);
+	}
+	sync_lamps(handles, scene->n_entries);
+
+	t = now_ns();
+	sent = lc_scene_activate(scene, handles, scene->n_entries,
+			options.repetitions);
+	t = now_ns() - t;
+
+	printf("activated `%.16s`: %u frames to %u lamps in %" PRIu64
+			" us\n", scene->name, sent, scene->n_entries,
+			t / 1000);
+
+	if (scene->n_entries > 0)
+		options.lamp.seq = handles[0].packet.sequence_number;
+
+	free(handles);
+	munmap(store, st.st_size);
+
+	return 0;
+}
+
+/*
+ * Adds the lamp to the scene options.scene in the scene store options.input or
+ * updates its entry. Both, the scene and the store, are created if necessary.
+ */
+static int run_save(void)
+{
+	FILE *f;
+	uint8_t *old, *buf;
+	size_t size, len, out, n;
+	struct lc_scene *scene;
+	struct lc_scene_entry entry;
+	int found;
+
+	memcpy(entry.addr, options.lamp.addr, sizeof(entry.addr));
+	entry.state = options.state;
+	entry.color = options.color;
+
+	size = 0;
+	old = NULL;
+
+	f = fopen(options.input, "rb");
+	if (f != NULL) {
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		old = malloc(size + 1);
+		if (old == NULL || fread(old, 1, size, f) != size) {
+			perror("error: cannot read scene store");
+			fclose(f);
+			free(old);
+			return -1;
+		}
+		fclose(f);
+	}
+
+	if (size == 0) {
+		size = LC_SCENE_MAGIC_LEN;
+		free(old);
+		old = malloc(size);
+		if (old == NULL) {
+			perror("error: cannot allocate scene store");
+			return -1;
+		}
+		memcpy(old, LC_SCENE_MAGIC, LC_SCENE_MAGIC_LEN);
+	}
+	else if (size < LC_SCENE_MAGIC_LEN
+			|| memcmp(old, LC_SCENE_MAGIC, LC_SCENE_MAGIC_LEN) != 0) {
+		fputs("error: not a scene store\n", stderr);
+		free(old);
+		return -1;
+	}
+
+	buf = malloc(size + sizeof(*scene) + sizeof(entry));
+	if (buf == NULL) {
+		perror("error: cannot allocate scene store");
+		free(old);
+		return -1;
+	}
+
+	memcpy(buf, old, LC_SCENE_MAGIC_LEN);
+	out = LC_SCENE_MAGIC_LEN;
+	found = 0;
+
+	for (len = LC_SCENE_MAGIC_LEN; size - len >= sizeof(*scene);) {
+		scene = (struct lc_scene *)(old + len);
+		n = sizeof(*scene) + scene->n_entries * sizeof(entry);
+		if (size - len < n)
+			break;
+
+		memcpy(buf + out, scene, n);
+		len += n;
+		scene = (struct lc_scene *)(buf + out);
+		out += n;
+
+		if (found || strncmp(scene->name, options.scene,
+				sizeof(scene->name)) != 0)
+			continue;
+
+		found = 1;
+		for (n = 0; n < scene->n_entries; n++) {
+			if (memcmp(scene->entry[n].addr, entry.addr,
+					sizeof(entry.addr)) == 0)
+				break;
+		}
+
+		if (n < scene->n_entries) {
+			scene->entry[n] = entry;
+		}
+		else if (n < LC_SCENE_MAX_ENTRIES) {
+			memcpy(buf + out, &entry, sizeof(entry));
+			scene->n_entries++;
+			out += sizeof(entry);
+		}
+		else {
+			fputs("error: scene is full\n", stderr);
+		}
+	}
+
+	if (!found) {
+		scene = (struct lc_scene *)(buf + out);
+		strncpy(scene->name, options.scene, sizeof(scene->name));
+		scene->n_entries = 1;
+		scene->entry[0] = entry;
+		out += sizeof(*scene) + sizeof(entry);
+	}
+
+	free(old);
+
+	f = fopen(options.input, "wb");
+	if (f == NULL || fwrite(buf, 1, out, f) != out) {
+		perror("error: cannot write scene store");
+		if (f != NULL)
+			fclose(f);
+		free(buf);
+		return -1;
+	}
+
+	fclose(f);
+	free(buf);
+
+	return 0;
+}
+
+/**
+ * The maximum number of commands that are executed as one batch.
+ */
+#define BATCH_SIZE	64
+
+struct batch {
+	struct lc_handle *handles;	/**< One handle per lamp seen so far. */
+	unsigned int n_handles;
+	unsigned int n_alloc;		/**< The number of allocated handles. */
+	struct {
+		unsigned int lamp;	/**< The index of the handle. */
+		int command;
+		struct color color;
+	} cmnd[BATCH_SIZE];		/**< The commands of the batch. */
+	unsigned int n_cmnds;
+	unsigned int n_frames;		/**< Frames sent in total. */
+};
+
+static struct lc_handle *batch_handle(struct batch *b, const uint8_t addr[9])
+{
+	struct lc_handle *h;
+	struct lc_lamp lamp;
+	unsigned int i;
+
+	for (i = 0; i < b->n_handles; i++) {
+		if (memcmp(b->handles[i].packet.address, addr, 9) == 0)
+			return &(b->handles[i]);
+	}
+
+	/* the batch refers to handles by index, so they may move */
+	if (b->n_handles == b->n_alloc) {
+		/* in the real-time profile, everything is allocated upfront */
+		if (options.priority > 0) {
+			errno = ENOSPC;
+			return NULL;
+		}
+
+		h = realloc(b->handles, (b->n_alloc > 0 ? 2 * b->n_alloc : 16)
+				* sizeof(*h));
+		if (h == NULL)
+			return NULL;
+		b->handles = h;
+		b->n_alloc = b->n_alloc > 0 ? 2 * b->n_alloc : 16;
+	}
+	h = b->handles;
+
+	memcpy(lamp.addr, addr, sizeof(lamp.addr));
+	lamp.seq = options.lamp.seq;
+	lc_handle_init(&h[b->n_handles], &lamp);
+
+	return &h[b->n_handles++];
+}
+
+/*
+ * Executes the commands of the batch. Every command is sent once before the
+ * repetitions of any of them, which go on air round-robin. Each lamp is
+ * repeated as often as it needs; a round is held back until the largest
+ * spacing of the lamps still being repeated has passed.
+ */
+static void batch_flush(struct batch *b)
+{
+	unsigned int i, j, n;
+	uint8_t left[BATCH_SIZE];
+	struct lc_handle *h;
+	uint16_t gap;
+	uint64_t start;
+
+	start = now_ns();
+	n = 0;
+	for (i = 0; i < b->n_cmnds; i++) {
+		h = &(b->handles[b->cmnd[i].lamp]);
+		switch (b->cmnd[i].command) {
+		case C_ON:
+			h->packet.color = b->cmnd[i].color;
+			left[i] = lc_handle_on(h);
+			break;
+		case C_OFF:
+			left[i] = lc_handle_off(h);
+			break;
+		default:
+			left[i] = lc_handle_set_color(h, &(b->cmnd[i].color));
+			break;
+		}
+		n += left[i];
+		if (left[i])
+			left[i] = repetitions(h) - 1;
+	}
+	b->n_frames += n;
+
+	/*
+	 * A handle only repeats its last frame, so the repetitions of a lamp
+	 * with several commands are moved to its last one.
+	 */
+	for (i = 0; i < b->n_cmnds; i++) {
+		for (j = i + 1; j < b->n_cmnds; j++) {
+			if (b->cmnd[j].lamp != b->cmnd[i].lamp)
+				continue;
+			if (left[i] > left[j])
+				left[j] = left[i];
+			left[i] = 0;
+			break;
+		}
+	}
+
+	for (;;) {
+		gap = 0;
+		for (i = 0; i < b->n_cmnds; i++) {
+			h = &(b->handles[b->cmnd[i].lamp]);
+			if (left[i] && options.repetitions == 0
+					&& lc_handle_spacing(h) > gap)
+				gap = lc_handle_spacing(h);
+		}
+
+		/* the frames of the last round already took their time */
+		if (gap > n * LC_FRAME_PERIOD_US)
+			sleep_until(start + (uint64_t)gap * 1000);
+
+		start = now_ns();
+		n = 0;
+		for (i = 0; i < b->n_cmnds; i++) {
+			if (!left[i])
+				continue;
+			lc_handle_repeat(&(b->handles[b->cmnd[i].lamp]));
+			left[i]--;
+			n++;
+		}
+		if (n == 0)
+			break;
+		b->n_frames += n;
+	}
+
+	b->n_cmnds = 0;
+}
+
+/*
+ * Adds a command to the batch. A color change is merged into a directly
+ * preceding color change of the same lamp, as only the latter would be
+ * visible anyway.
+ */
+static void batch_add(struct batch *b, struct lc_handle *h, int command,
+		const struct color *color)
+{
+	unsigned int i, lamp;
+
+	lamp = h - b->handles;
+	for (i = b->n_cmnds; i > 0; i--) {
+		if (b->cmnd[i - 1].lamp != lamp)
+			continue;
+
+		if (command == C_SET && b->cmnd[i - 1].command == C_SET) {
+			b->cmnd[i - 1].color = *color;
+			return;
+		}
+		break;
+	}
+
+	if (b->n_cmnds == BATCH_SIZE)
+		batch_flush(b);
+
+	b->cmnd[b->n_cmnds].lamp = lamp;
+	b->cmnd[b->n_cmnds].command = command;
+	b->cmnd[b->n_cmnds].color = *color;
+	b->n_cmnds++;
+}
+
+/*
+ * Parses a line of the form `<address> <command> [<color>] [@<ms>]`.
+ *
+ * \return	0 on success, 1 for empty lines and comments, -1 otherwise.
+ */
+static int parse_line(char *line, uint8_t addr[9], int *command,
+		struct color *color, long *ms)
+{
+	char *tok, *save;
+
+	*ms = -1;
+
+	tok = strtok_r(line, " \t\r\n", &save);
+	if (tok == NULL || tok[0] == '#')
+		return 1;
+	if (parse_address(tok, addr) != 0)
+		return -1;
+
+	tok = strtok_r(NULL, " \t\r\n", &save);
+	if (tok == NULL)
+		return -1;
+	*command = parse_command(tok);
+	if (*command != C_ON && *command != C_OFF && *command != C_SET)
+		return -1;
+
+	while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+		if (tok[0] == '@')
+			*ms = atol(tok + 1);
+		else if (parse_color(tok, color) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Executes a stream of commands from the input file, or from stdin, over the
+ * radio that has been initialized once.
+ *
+ * Commands are collected into batches for as long as further input is readily
+ * available. With options.timestamps, a command with a timestamp is held back
+ * until that many milliseconds have passed since the start.
+ */
+static int run_batch(void)
+{
+	int fd, ret;
+	char buf[4096], *line, *nl;
+	size_t len;
+	ssize_t n;
+	struct batch b = {0};
+	struct lc_handle *h;
+	struct pollfd pfd;
+	struct timespec ts;
+	struct color color;
+	uint8_t addr[9];
+	uint64_t start, at;
+	unsigned int lineno, n_cmnds;
+	int command;
+	long ms;
+
+	fd = STDIN_FILENO;
+	if (options.input != NULL) {
+		fd = open(options.input, O_RDONLY);
+		if (fd < 0) {
+			perror("error: cannot open input");
+			return -1;
+		}
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	start = now_ns();
+	len = 0;
+	lineno = n_cmnds = 0;
+
+	for (;;) {
+		n = read(fd, buf + len, sizeof(buf) - 1 - len);
+		if (n < 0) {
+			perror("error: cannot read input");
+			break;
+		}
+		len += n;
+		buf[len] = '\0';
+
+		line = buf;
+		while ((nl = strchr(line, '\n')) != NULL
+				|| (n == 0 && *line != '\0')) {
+			if (nl != NULL)
+				*nl = '\0';
+			lineno++;
+
+			/* a line without a color does not inherit the last one */
+			color = options.color;
+			ret = parse_line(line, addr, &command, &color, &ms);
+			line = nl != NULL ? nl + 1 : line + strlen(line);
+			if (ret > 0)
+				continue;
+			if (ret < 0) {
+				fprintf(stderr, "licor: line %u malformed\n",
+						lineno);
+				continue;
+			}
+
+			if (options.timestamps && ms >= 0) {
+				batch_flush(&b);
+				at = start + (uint64_t)ms * 1000000;
+				ts.tv_sec = at / 1000000000;
+				ts.tv_nsec = at % 1000000000;
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+						&ts, NULL);
+			}
+
+			h = batch_handle(&b, addr);
+			if (h == NULL) {
+				perror("error: cannot allocate handle");
+				continue;
+			}
+
+			batch_add(&b, h, command, &color);
+			n_cmnds++;
+
+			if (options.timestamps && ms >= 0)
+				batch_flush(&b);
+		}
+
+		len = buf + len - line;
+		memmove(buf, line, len);
+
+		if (n == 0)
+			break;
+
+		if (len == sizeof(buf) - 1) {
+			fprintf(stderr, "licor: line %u too long\n",
+					lineno + 1);
+			len = 0;
+		}
+
+		/*
+		 * Go on air as soon as there is no more input at hand.
+		 */
+		if (poll(&pfd, 1, 0) == 0)
+			batch_flush(&b);
+	}
+
+	batch_flush(&b);
+
+	if (options.verbose)
+		printf("%u commands for %u lamps, %u frames in %" PRIu64
+				" ms\n", n_cmnds, b.n_handles, b.n_frames,
+				(now_ns() - start) / 1000000);
+
+	/*
+	 * Keep the most advanced sequence number for the next invocation.
+	 */
+	for (lineno = 0; lineno < b.n_handles; lineno++) {
+		h = &(b.handles[lineno]);
+		if ((uint8_t)(h->packet.sequence_number - options.lamp.seq)
+				< 128)
+			options.lamp.seq = h->packet.sequence_number;
+	}
+
+	free(b.handles);
+	if (fd != STDIN_FILENO)
+		close(fd);
+
+	return n < 0 ? -1 : 0;
+}
+
+/**
+ * The maximum number of mismatching registers that are reported.
+ */
+#define MAX_MISMATCHES	16
+
+/*
+ * Verifies the configuration of the CC2500 and reports the registers that
+ * differ, optionally repairing them.
+ *
+ * \return	The number of registers that differed.
+ */
+static unsigned int check_radio(int repair)
+{
+	struct lc_mismatch m[MAX_MISMATCHES];
+	unsigned int i, n;
+
+	n = lc_verify(m, MAX_MISMATCHES, repair);
+
+	for (i = 0; i < n && i < MAX_MISMATCHES; i++) {
+		if (m[i].addr == 0x3E)	/* the PA table */
+			fprintf(stderr, "PATABLE[%hhu]: ", m[i].index);
+		else
+			fprintf(stderr, "register 0x%02hhx: ", m[i].addr);
+		fprintf(stderr, "expected 0x%02hhx, read 0x%02hhx\n",
+				m[i].expected, m[i].actual);
+	}
+	if (n > 0)
+		fprintf(stderr, "%u registers differ%s\n", n,
+				repair ? ", rewritten" : "");
+
+	return n;
+}
+
+/**
+ * The interval in seconds in which the configuration of the CC2500 is checked
+ * and repaired while serving.
+ */
+#define VERIFY_PERIOD_S	10
+
+/**
+ * The maximum number of clients that are served at the same time.
+ */
+#define MAX_CONNS	16
+
+/**
+ * The maximum number of lamps that are served in the real-time profile, for
+ * which all handles are allocated at startup.
+ */
+#define MAX_LAMPS_RT	256
+
+/**
+ * The number of commands that the ring of `serve` holds, see -u.
+ */
+#define RING_SLOTS	4096
+
+/**
+ * The interval in ms in which frames heard by the radio are picked up while
+ * serving.
+ */
+#define SNIFF_PERIOD_MS	20
+
+/**
+ * A client of `serve`. Its socket is non-blocking, and whatever it does not
+ * take right away is kept and sent once it becomes writable.
+ */
+struct conn {
+	int fd;			/**< The socket, or -1 if unused. */
+	int ws;			/**< Whether the handshake is done. */
+	int closing;		/**< Whether to close once all is sent. */
+	size_t len;		/**< The number of bytes in `buf`. */
+	uint8_t buf[2048];	/**< Data received but not processed yet. */
+	size_t n_out;		/**< The number of bytes in `out`. */
+	uint8_t out[512];	/**< Data to send before `page`. */
+	const char *page;	/**< The rest of the index page to send. */
+	size_t n_page;		/**< The number of bytes left of `page`. */
+};
+
+/**
+ * The index page of the web interface, which is read once when serving starts.
+ */
+static struct {
+	char *data;
+	size_t size;
+} index_page;
+
+/**
+ * The most recent command for a lamp that has not been sent yet.
+ */
+struct pending {
+	int command;		/**< One of `COMMANDS`, or -1 if none. */
+	struct color color;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+	quit = 1;
+}
+
+static void conn_open(struct conn *c, int fd)
+{
+	c->fd = fd;
+	c->ws = 0;
+	c->closing = 0;
+	c->len = 0;
+	c->n_out = 0;
+	c->page = NULL;
+	c->n_page = 0;
+}
+
+static void conn_close(struct conn *c)
+{
+	close(c->fd);
+	c->fd = -1;
+}
+
+/*
+ * Writes as much of the queued data as the socket takes without blocking, and
+ * closes the connection once it is all sent if it is closing.
+ */
+static void conn_flush(struct conn *c)
+{
+	ssize_t len;
+
+	while (c->n_out > 0) {
+		len = write(c->fd, c->out, c->n_out);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			return;
+		if (len <= 0) {
+			conn_close(c);
+			return;
+		}
+
+		memmove(c->out, c->out + len, c->n_out - len);
+		c->n_out -= len;
+	}
+
+	while (c->n_page > 0) {
+		len = write(c->fd, c->page, c->n_page);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			return;
+		if (len <= 0) {
+			conn_close(c);
+			return;
+		}
+
+		c->page += len;
+		c->n_page -= len;
+	}
+
+	if (c->closing)
+		conn_close(c);
+}
+
+/*
+ * Queues `n` bytes to be sent on the connection and sends what the socket
+ * takes. A client that lets the queue fill up is disconnected.
+ */
+static void conn_send(struct conn *c, const void *data, size_t n)
+{
+	if (n > sizeof(c->out) - c->n_out) {
+		conn_close(c);
+		return;
+	}
+
+	memcpy(c->out + c->n_out, data, n);
+	c->n_out += n;
+
+	conn_flush(c);
+}
+
+/*
+ * Reads the index page of the web interface into `index_page`. Without it,
+ * every request is answered with 404.
+ */
+static void load_page(void)
+{
+	char path[256];
+	FILE *f;
+	long size;
+
+	snprintf(path, sizeof(path), "%s/index.html", options.www);
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		perror("warning: cannot open the web interface");
+		return;
+	}
+
+	if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0
+			&& fseek(f, 0, SEEK_SET) == 0) {
+		index_page.data = malloc(size);
+		if (index_page.data != NULL
+				&& fread(index_page.data, 1, size, f)
+				== (size_t)size)
+			index_page.size = size;
+	}
+	if (index_page.size == 0) {
+		perror("warning: cannot read the web interface");
+		free(index_page.data);
+		index_page.data = NULL;
+	}
+
+	fclose(f);
+}
+
+/*
+ * Answers a plain HTTP request with the index page and closes the connection
+ * once it has been sent.
+ */
+static void serve_page(struct conn *c)
+{
+	char hdr[128];
+	size_t n;
+
+	c->closing = 1;
+
+	if (index_page.data == NULL
+			|| strncmp((char *)c->buf, "GET / ", 6) != 0) {
+		n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 404 Not Found\r\n"
+				"Content-Length: 0\r\n"
+				"Connection: close\r\n\r\n");
+		conn_send(c, hdr, n);
+		return;
+	}
+
+	n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/html\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n", index_page.size);
+	c->page = index_page.data;
+	c->n_page = index_page.size;
+	conn_send(c, hdr, n);
+}
+
+/*
+ * Makes the command the pending one of the lamp at `addr`, replacing any
+ * command that has not been sent yet.
+ */
+static void serve_command(struct batch *b, struct pending **pending,
+		unsigned int *n_pending, const uint8_t addr[9], int command,
+		const struct color *color)
+{
+	struct lc_handle *h;
+	struct pending *p;
+	size_t i;
+
+	h = batch_handle(b, addr);
+	if (h == NULL)
+		return;
+
+	i = h - b->handles;
+	if (i >= *n_pending) {
+		p = realloc(*pending, b->n_handles * sizeof(*p));
+		if (p == NULL)
+			return;
+		for (; *n_pending < b->n_handles; (*n_pending)++)
+			p[*n_pending].command = -1;
+		*pending = p;
+	}
+
+	(*pending)[i].command = command;
+	(*pending)[i].color = *color;
+}
+
+/*
+ * Processes the data received on a connection. Commands received through the
+ * WebSocket replace any pending command for the same lamp.
+ */
+static void serve_conn(struct conn *c, struct batch *b,
+		struct pending **pending, unsigned int *n_pending)
+{
+	char resp[256], line[128];
+	uint8_t *payload, addr[9], frame[127];
+	struct color color;
+	size_t hdr, n;
+	int ret, opcode, command;
+	long ms;
+
+	if (!c->ws) {
+		c->buf[c->len] = '\0';
+
+		hdr = http_header_complete((char *)c->buf, c->len);
+		if (hdr == 0) {
+			if (c->len == sizeof(c->buf) - 1)
+				conn_close(c);
+			return;
+		}
+
+		if (ws_handshake((char *)c->buf, resp, sizeof(resp)) != 0) {
+			serve_page(c);
+			return;
+		}
+
+		conn_send(c, resp, strlen(resp));
+		if (c->fd < 0)
+			return;
+		c->ws = 1;
+		memmove(c->buf, c->buf + hdr, c->len - hdr);
+		c->len -= hdr;
+	}
+
+	while ((ret = ws_decode(c->buf, c->len, &opcode, &payload, &n)) > 0) {
+		switch (opcode) {
+		case WS_TEXT:
+			n = n < sizeof(line) ? n : sizeof(line) - 1;
+			memcpy(line, payload, n);
+			line[n] = '\0';
+
+			color = options.color;
+			if (parse_line(line, addr, &command, &color, &ms) != 0)
+				break;
+
+			serve_command(b, pending, n_pending, addr, command,
+					&color);
+			break;
+		case WS_PING:
+			n = ws_encode(frame, WS_PONG, payload, n);
+			conn_send(c, frame, n);
+			if (c->fd < 0)
+				return;
+			break;
+		case WS_CLOSE:
+			n = ws_encode(frame, WS_CLOSE, NULL, 0);
+			c->closing = 1;
+			conn_send(c, frame, n);
+			return;
+		default:
+			break;
+		}
+
+		memmove(c->buf, c->buf + ret, c->len - ret);
+		c->len -= ret;
+	}
+
+	if (ret < 0)
+		conn_close(c);
+}
+
+/*
+ * Takes all commands out of the ring, as pending commands.
+ */
+static void serve_ring(struct ring *r, struct batch *b,
+		struct pending **pending, unsigned int *n_pending)
+{
+	struct ring_cmnd c;
+
+	while (ring_take(r, &c)) {
+		if (c.command > RING_SET)
+			continue;
+		serve_command(b, pending, n_pending, c.addr, c.command,
+				&c.color);
+	}
+}
+
+/*
+ * Serves the web interface and accepts commands for the lamps through
+ * WebSockets, as lines in the format of the batch mode, and with -u through
+ * the shared-memory ring, see ring_create().
+ *
+ * Commands for the same lamp are coalesced until the radio is ready for the
+ * next round, so that a slider streaming its value only ever results in a
+ * single frame per lamp and round.
+ */
+static int run_serve(void)
+{
+	int lfd, fd, one;
+	struct sockaddr_in sa = {0};
+	struct pollfd pfd[MAX_CONNS + 3];
+	struct ring ring = {.shm = NULL, .memfd = -1, .doorbell = -1};
+	int rfd;
+	struct conn conns[MAX_CONNS];
+	struct batch b = {0};
+	struct pending *pending;
+	struct sigaction sigact = {0};
+	struct lc_rx rx;
+	unsigned int i, n_pending, n;
+	uint64_t next, now, next_check;
+	ssize_t len;
+	int timeout;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		perror("error: cannot create socket");
+		return -1;
+	}
+
+	one = 1;
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(options.port);
+	sa.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) != 0
+			|| listen(lfd, 8) != 0) {
+		perror("error: cannot listen");
+		close(lfd);
+		return -1;
+	}
+
+	rfd = -1;
+	if (options.ring != NULL) {
+		if (ring_create(&ring, RING_SLOTS) != 0
+				|| (rfd = ring_listen(options.ring)) < 0) {
+			perror("error: cannot offer ring");
+			ring_close(&ring);
+			close(lfd);
+			return -1;
+		}
+	}
+
+	sigact.sa_handler = on_signal;
+	sigaction(SIGINT, &sigact, NULL);
+	sigaction(SIGTERM, &sigact, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < MAX_CONNS; i++)
+		conns[i].fd = -1;
+
+	load_page();
+
+	pending = NULL;
+	n_pending = 0;
+	next = 0;
+	next_check = now_ns() + (uint64_t)VERIFY_PERIOD_S * 1000000000;
+
+	if (options.priority > 0) {
+		b.handles = calloc(MAX_LAMPS_RT, sizeof(*b.handles));
+		pending = calloc(MAX_LAMPS_RT, sizeof(*pending));
+		if (b.handles == NULL || pending == NULL) {
+			perror("error: cannot allocate handles");
+			free(b.handles);
+			free(pending);
+			close(lfd);
+			if (rfd >= 0)
+				close(rfd);
+			ring_close(&ring);
+			return -1;
+		}
+		rt_prefault(b.handles, MAX_LAMPS_RT * sizeof(*b.handles));
+		b.n_alloc = MAX_LAMPS_RT;
+		for (n_pending = 0; n_pending < MAX_LAMPS_RT; n_pending++)
+			pending[n_pending].command = -1;
+	}
+
+	lc_listen();
+
+	while (!quit) {
+		/*
+		 * Wait for the radio if there is something to send, and
+		 * come back regularly to pick up the frames it heard.
+		 */
+		timeout = SNIFF_PERIOD_MS;
+		for (i = 0; i < n_pending; i++) {
+			if (pending[i].command >= 0) {
+				now = now_ns();
+				if (next <= now)
+					timeout = 0;
+				else if ((next - now) / 1000000 + 1
+						< SNIFF_PERIOD_MS)
+					timeout = (next - now) / 1000000 + 1;
+				break;
+			}
+		}
+
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < MAX_CONNS; i++) {
+			pfd[i + 1].fd = conns[i].fd;
+			pfd[i + 1].events = conns[i].closing ? 0 : POLLIN;
+			if (conns[i].n_out > 0 || conns[i].n_page > 0)
+				pfd[i + 1].events |= POLLOUT;
+		}
+		pfd[MAX_CONNS + 1].fd = rfd;
+		pfd[MAX_CONNS + 1].events = POLLIN;
+		pfd[MAX_CONNS + 2].fd = ring.doorbell;
+		pfd[MAX_CONNS + 2].events = POLLIN;
+
+		/* the producers only ring the doorbell while we wait */
+		if (rfd >= 0 && !ring_idle(&ring))
+			timeout = 0;
+
+		if (poll(pfd, MAX_CONNS + 3, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("error: poll");
+			break;
+		}
+
+		if (rfd >= 0) {
+			ring_ack(&ring);
+			if (pfd[MAX_CONNS + 1].revents & POLLIN)
+				ring_offer(rfd, &ring);
+			serve_ring(&ring, &b, &pending, &n_pending);
+		}
+
+		/* keep the link estimates and state mirrors current */
+		while (lc_receive(&rx))
+			lc_observe(b.handles, b.n_handles, &rx);
+
+		if (pfd[0].revents & POLLIN) {
+			fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+			for (i = 0; fd >= 0 && i < MAX_CONNS; i++) {
+				if (conns[i].fd < 0) {
+					conn_open(&conns[i], fd);
+					break;
+				}
+			}
+			if (fd >= 0 && i == MAX_CONNS)
+				close(fd);
+		}
+
+		for (i = 0; i < MAX_CONNS; i++) {
+			if (conns[i].fd < 0 || pfd[i + 1].revents == 0)
+				continue;
+
+			/* a failed socket fails the write, if any is due */
+			conn_flush(&conns[i]);
+			if (conns[i].fd < 0 || conns[i].closing
+					|| (pfd[i + 1].revents & ~POLLOUT) == 0)
+				continue;
+
+			/* one byte is left for terminating the HTTP request */
+			len = read(conns[i].fd, conns[i].buf + conns[i].len,
+					sizeof(conns[i].buf) - 1 - conns[i].len);
+			if (len < 0 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			if (len <= 0) {
+				conn_close(&conns[i]);
+				continue;
+			}
+
+			conns[i].len += len;
+			serve_conn(&conns[i], &b, &pending, &n_pending);
+		}
+
+		now = now_ns();
+		if (now >= next_check) {
+			check_radio(1);
+			next_check = now + (uint64_t)VERIFY_PERIOD_S
+					* 1000000000;
+		}
+
+		if (now < next)
+			continue;
+
+		for (i = 0; i < n_pending; i++) {
+			if (pending[i].command < 0)
+				continue;
+			batch_add(&b, &(b.handles[i]), pending[i].command,
+					&(pending[i].color));
+			pending[i].command = -1;
+		}
+
+		n = b.n_frames;
+		batch_flush(&b);
+		next = now + (uint64_t)(b.n_frames - n) * LC_FRAME_PERIOD_US
+				* 1000;
+	}
+
+	for (i = 0; i < MAX_CONNS; i++) {
+		if (conns[i].fd >= 0)
+			conn_close(&conns[i]);
+	}
+	close(lfd);
+	if (rfd >= 0) {
+		close(rfd);
+		unlink(options.ring);
+	}
+	ring_close(&ring);
+
+	for (i = 0; i < b.n_handles; i++) {
+		if ((uint8_t)(b.handles[i].packet.sequence_number
+				- options.lamp.seq) < 128)
+			options.lamp.seq = b.handles[i].packet.sequence_number;
+	}
+
+	if (options.verbose)
+		printf("%u lamps, %u frames\n", b.n_handles, b.n_frames);
+
+	free(pending);
+	free(b.handles);
+	free(index_page.data);
+	index_page.data = NULL;
+	index_page.size = 0;
+
+	return 0;
+}
+
+/*
+ * Submits the commands in options.input, or from stdin, to the ring of a
+ * running `serve`, see -u. The lines are in the format of the batch mode but
+ * timestamps are ignored; while the ring is full, submitting is held back.
+ */
+static int run_push(void)
+{
+	struct ring r;
+	struct ring_cmnd c;
+	struct timespec ts = {0, 1000000};
+	FILE *f;
+	char *line;
+	size_t size;
+	unsigned int lineno, n;
+	uint64_t t;
+	int command, ret;
+	long ms;
+
+	if (options.ring == NULL) {
+		fputs("licor: push needs -u SOCKET\n", stderr);
+		return -1;
+	}
+
+	if (ring_connect(options.ring, &r) != 0) {
+		perror("error: cannot connect to ring");
+		return -1;
+	}
+
+	f = stdin;
+	if (options.input != NULL) {
+		f = fopen(options.input, "r");
+		if (f == NULL) {
+			perror("error: cannot open input");
+			ring_close(&r);
+			return -1;
+		}
+	}
+
+	line = NULL;
+	size = 0;
+	lineno = n = 0;
+	t = now_ns();
+	while (getline(&line, &size, f) >= 0) {
+		lineno++;
+
+		c.color = options.color;
+		ret = parse_line(line, c.addr, &command, &c.color, &ms);
+		if (ret == 1)
+			continue;
+		if (ret != 0) {
+			fprintf(stderr, "licor: line %u malformed\n", lineno);
+			continue;
+		}
+
+		c.command = (uint8_t)command;
+		while (ring_submit(&r, &c) != 0)
+			nanosleep(&ts, NULL);
+		n++;
+	}
+	t = now_ns() - t;
+
+	if (options.verbose)
+		printf("%u commands in %" PRIu64 " us\n", n, t / 1000);
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	ring_close(&r);
+
+	return 0;
+}
+
+/*
+ * Sends the packets of the capture file options.input again, with the timing
+ * of the capture sped up by options.speed, or as fast as possible if that is 0.
+ * Packets that had been received are replayed as well.
+ */
+static int run_replay(void)
+{
+	const struct capture_record *r;
+	struct timespec ts;
+	size_t n, i;
+	uint64_t start, at, late, late_max, t;
+
+	r = capture_map(options.input, &n);
+	if (r == NULL)
+		return -1;
+
+	late_max = 0;
+	start = now_ns();
+
+	for (i = 0; i < n; i++) {
+		if (options.speed > 0) {
+			at = start + (uint64_t)((r[i].timestamp
+					- r[0].timestamp) / options.speed);
+			ts.tv_sec = at / 1000000000;
+			ts.tv_nsec = at % 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL);
+
+			late = now_ns() - at;
+			if (late > late_max)
+				late_max = late;
+		}
+
+		lc_send_packet(&(r[i].packet));
+	}
+
+	t = now_ns() - start;
+
+	printf("%zu packets in %" PRIu64 " ms (%.0f packets/s), captured in %"
+			PRIu64 " ms", n, t / 1000000,
+			n * 1e9 / (t > 0 ? t : 1), n > 0
+				? (r[n - 1].timestamp - r[0].timestamp)
+					/ 1000000 : 0);
+	if (options.speed > 0)
+		printf(", max lateness %" PRIu64 " us", late_max / 1000);
+	putchar('\n');
+
+	capture_unmap(r, n);
+
+	return 0;
+}
+
+/*
+ * The line that GDO2 of the CC2500 is wired to, see -g.
+ */
+static int gdo_fd = -1;
+
+static int wait_gdo(uint32_t timeout_us)
+{
+	return gpio_wait_edge(gdo_fd, timeout_us / 1000 + 1);
+}
+
+/**
+ * The maximum number of lamps that a scan reports.
+ */
+#define SCAN_MAX_LAMPS	16
+
+/*
+ * Listens for options.seconds for the traffic of other remotes and prints the
+ * addresses of the lamps they control, in the format of the batch mode.
+ */
+static int run_scan(void)
+{
+	struct lc_lamp lamps[SCAN_MAX_LAMPS];
+	int i, n;
+
+	n = lc_learn(lamps, SCAN_MAX_LAMPS, options.seconds);
+	if (n < 0) {
+		perror("error: cannot scan");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		printf("%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:"
+				"%02hhx  next sequence number %hhu\n",
+				lamps[i].addr[0], lamps[i].addr[1],
+				lamps[i].addr[2], lamps[i].addr[3],
+				lamps[i].addr[4], lamps[i].addr[5],
+				lamps[i].addr[6], lamps[i].addr[7],
+				lamps[i].addr[8], lamps[i].seq);
 	}
 
+	if (options.verbose)
+		printf("%d lamps found\n", n);
+
 	return 0;
 }
 
-int spi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+/*
+ * Sends options.n_samples frames through h, one frame period apart, and prints
+ * the distribution of the time from each scheduled wake-up to the STX strobe
+ * of the frame. Run with -R to see what the real-time profile buys.
+ */
+static int run_latency(struct lc_handle *h)
 {
-	int ret;
-	struct spi_ioc_transfer tr = {0};
+	uint64_t *samples, at, stx;
+	struct rt_latency l;
+	unsigned int i;
 
-	if (options.verbose) {
-		if (tx_buf != NULL) {
-			puts("tx_buf:");
-			for (ret = 0; ret < n_bytes; ret++) {
-				printf("%#02hhx ", ((uint8_t *)tx_buf)[ret]);
-				if (ret % 26 == 0)
-					puts("\n");
-			}
-			puts("\n");
-		}
-		if (rx_buf != NULL) {
-			puts("rx_buf:");
-			for (ret = 0; ret < n_bytes; ret++) {
-				printf("%#02hhx ", ((uint8_t *)rx_buf)[ret]);
-				if (ret % 26 == 0)
-					puts("\n");
-			}
-			puts("\n");
-		}
+	samples = malloc(options.n_samples * sizeof(*samples));
+	if (samples == NULL) {
+		perror("error: cannot allocate samples");
+		return -1;
 	}
+	rt_prefault(samples, options.n_samples * sizeof(*samples));
 
-	tr.tx_buf = (unsigned long)tx_buf;
-	tr.rx_buf = (unsigned long)rx_buf;
-	tr.len = n_bytes;
-	tr.delay_usecs = 100;
-	tr.speed_hz = 5000000;
-	tr.bits_per_word = 8;
-	tr.cs_change = 0;
+	lc_handle_set_color(h, NULL);
 
-	ret = ioctl(spi, SPI_IOC_MESSAGE(1), &tr);
-	if (ret < 1) {
-		perror("can't send spi message");
-		return -1;
+	stx_ns = &stx;
+	at = now_ns();
+	for (i = 0; i < options.n_samples; i++) {
+		at += (uint64_t)LC_FRAME_PERIOD_US * 1000;
+		sleep_until(at);
+		lc_handle_repeat(h);
+		samples[i] = stx - at;
 	}
+	stx_ns = NULL;
+
+	rt_latency(samples, i, &l);
+	printf("wake-up to STX over %u frames%s:\n"
+			"\tmin %" PRIu64 " us, p50 %" PRIu64 " us, p90 %"
+			PRIu64 " us, p99 %" PRIu64 " us, p99.9 %" PRIu64
+			" us, max %" PRIu64 " us\n", i,
+			options.priority > 0 ? " (real-time)" : "",
+			l.min / 1000, l.p50 / 1000, l.p90 / 1000,
+			l.p99 / 1000, l.p999 / 1000, l.max / 1000);
+
+	free(samples);
 
 	return 0;
 }
 
-enum COMMANDS {
-	C_ON = 0, C_OFF = 1, C_SET = 2, C_SCAN = 3
-};
+/**
+ * The size of the transfers of the SPI benchmark: a burst read of the whole
+ * configuration space, which has no side effects.
+ */
+#define BENCH_BYTES	48
 
-static int parse_address(const char *s, uint8_t addr[9])
+/*
+ * Performs options.n_samples burst transfers and reports the bit rate that the
+ * SPI achieves, which is useful to tune the soft SPI.
+ */
+static int run_bench(void)
 {
-	int ret;
+	uint8_t buf[BENCH_BYTES];
+	uint64_t t;
+	unsigned int i;
+	double bytes;
 
-	ret = sscanf(s, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-			&addr[0], &addr[1], &addr[2], &addr[3], &addr[4],
-			&addr[5], &addr[6], &addr[7], &addr[8]);
-	if (ret == 9)
-		return 0;
+	t = now_ns();
+	for (i = 0; i < options.n_samples; i++) {
+		memset(buf, 0, sizeof(buf));
+		buf[0] = 0xC0;	/* burst read from IOCFG2 */
+		if (spi_transfer(buf, buf, sizeof(buf)) != 0) {
+			perror("error: SPI transfer failed");
+			return -1;
+		}
+	}
+	t = now_ns() - t;
 
-	return -1;
+	bytes = (double)options.n_samples * BENCH_BYTES;
+	printf("%.0f bytes in %" PRIu64 " us: %.1f kbit/s\n", bytes,
+			t / 1000, bytes * 8 * 1000000 / (t > 0 ? t : 1));
+
+	if (is_gpio())
+		printf("soft SPI aiming for %" PRIu32 " kHz, %.1f line "
+				"writes and %.1f reads per byte\n",
+				softspi_hz() / 1000,
+				softspi_stats.sets / bytes,
+				softspi_stats.gets / bytes);
+
+	return 0;
 }
 
-static int parse_command(const char *cmnd)
+/*
+ * Sends options.rounds updates to every lamp of the farm, a color change each
+ * apart from the first, which turns the lamps on. The updates of a round go
+ * through the batches of the batch mode, the delivery is reported by main().
+ */
+static int run_farm(void)
 {
-	if (strncmp(cmnd, "on", 2) == 0) {
-		return C_ON;
+	struct batch b = {0};
+	struct lc_handle *h;
+	struct color color;
+	uint8_t addr[9];
+	unsigned int r, i;
+
+	if (!is_farm()) {
+		fputs("error: the farm needs `-d farm:N`\n", stderr);
+		return -1;
 	}
-	else if (strncmp(cmnd, "off", 3) == 0) {
-		return C_OFF;
+
+	for (r = 0; r < options.rounds; r++) {
+		for (i = 0; i < farm_n_lamps(); i++) {
+			farm_address(i, addr);
+			h = batch_handle(&b, addr);
+			if (h == NULL) {
+				perror("error: cannot allocate handle");
+				free(b.handles);
+				return -1;
+			}
+
+			/* a different color for each lamp in each round */
+			color.hue = (uint8_t)(i * 37 + r * 101);
+			color.saturation = 255;
+			color.value = 255;
+			batch_add(&b, h, r == 0 ? C_ON : C_SET, &color);
+		}
+		batch_flush(&b);
 	}
-	else if (strncmp(cmnd, "set", 3) == 0) {
-		return C_SET;
+
+	if (options.verbose)
+		printf("%u rounds, %u frames\n", options.rounds, b.n_frames);
+
+	free(b.handles);
+
+	return 0;
+}
+
+/*
+ * The base frequency and the channel spacing as configured by lc_init(), in
+ * kHz.
+ */
+#define BASE_FREQ_KHZ	2433000
+#define CHANNEL_KHZ	200
+
+/*
+ * Sweeps the channels options.repetitions times, but at least once, and prints
+ * the strongest signal seen on each of them.
+ */
+static int run_sweep(void)
+{
+	struct lc_channel *ch;
+	unsigned int i, loudest;
+	int8_t *peak;
+	uint64_t t, t_first;
+	int r;
+
+	ch = calloc(options.n_channels, sizeof(*ch));
+	peak = malloc(options.n_channels);
+	if (ch == NULL || peak == NULL) {
+		perror("error: cannot allocate channels");
+		free(ch);
+		free(peak);
+		return -1;
 	}
-	else if (strncmp(cmnd, "scan", 4) == 0) {
-		return C_SCAN;
+
+	memset(peak, INT8_MIN, options.n_channels);
+	t_first = t = 0;
+
+	for (r = 0; r < options.repetitions || r == 0; r++) {
+		t = now_ns();
+		if (lc_sweep(ch, options.first, options.n_channels) != 0) {
+			perror("error: cannot sweep");
+			free(ch);
+			free(peak);
+			return -1;
+		}
+		t = now_ns() - t;
+		if (r == 0)
+			t_first = t;
+
+		for (i = 0; i < options.n_channels; i++) {
+			if (ch[i].rssi > peak[i])
+				peak[i] = ch[i].rssi;
+		}
 	}
-	else {
-		return -1;
+
+	loudest = 0;
+	for (i = 0; i < options.n_channels; i++) {
+		if (peak[i] > peak[loudest])
+			loudest = i;
+
+		printf("%3u  %4u.%03u MHz  %4d dBm  ", options.first + i,
+				(BASE_FREQ_KHZ + (options.first + i)
+					* CHANNEL_KHZ) / 1000,
+				(BASE_FREQ_KHZ + (options.first + i)
+					* CHANNEL_KHZ) % 1000, peak[i]);
+		for (r = -110; r < peak[i]; r += 4)
+			putchar('#');
+		putchar('\n');
 	}
-}
 
-static int parse_color(char *s, struct color *c)
-{
-	int ret;
+	printf("strongest signal on channel %u, first sweep %" PRIu64
+			" us, last sweep %" PRIu64 " us\n",
+			options.first + loudest, t_first / 1000, t / 1000);
 
-	ret = sscanf(s, "%hhu,%hhu,%hhu",
-			&(c->hue),
-			&(c->saturation),
-			&(c->value));
-	if (ret == 3)
-		return 0;
+	free(peak);
+	free(ch);
 
-	return -1;
+	return 0;
 }
 
 const char *argp_program_version = "licor 0.1";
@@ -183,11 +2115,40 @@ const char *argp_program_bug_address = "<darius.kellermann@gmail.com>";
 static struct argp_option argp_options[]  = {
 		{"address", 'a', "ADDR", 0, "The 9 byte long address of the "
 				"lamp that should be controlled"},
-		{"device", 'd', "DEVICE", 0, "The SPI device to use"},
+		{"capture", 'c', "FILE", 0, "Record all packets sent and "
+				"received to FILE"},
+		{"device", 'd', "DEVICE", 0, "The SPI device to use, `emu` "
+				"selects an emulated CC2500, `farm:N[,LOSS[,DELAY]]` "
+				"one with N virtual lamps around it, `gpio:CHIP,SCLK,"
+				"MOSI,MISO,CSN[,HZ]` a soft SPI on GPIO lines"},
 		{"repetitions", 'r', "N", 0, "The number of times the according"
-				" command package is sent (hotfix option)"},
+				" command package is sent, 0 or `auto` adapts it "
+				"to the link of each lamp"},
 		{"sequence", 's', "SEQNUM", 0, "The sequence number to use for "
 				"the packet"},
+		{"www", 'w', "DIR", 0, "The directory of the web interface "
+				"(default /srv/http)"},
+		{"realtime", 'R', "PRIO[,CPU]", 0, "Run with the SCHED_FIFO "
+				"priority PRIO (1-99), pinned to CPU, with all "
+				"memory locked"},
+		{"gdo", 'g', "CHIP,LINE", 0, "The GPIO line that GDO2 of the "
+				"CC2500 is wired to, which lets scan sniff with "
+				"Wake-on-Radio"},
+		{"confirm", 'C', "US", 0, "Wait up to US microseconds for "
+				"the lamp to answer each frame and repeat the "
+				"command only if it does not"},
+		{"ring", 'u', "SOCKET", 0, "Offer a shared-memory command "
+				"ring to local processes on the Unix socket "
+				"SOCKET while serving, resp. the socket to push "
+				"to"},
+		{"sync", 'y', "MS", 0, "Listen MS milliseconds for the "
+				"original remote before sending, to continue "
+				"its sequence numbers"},
+		{"timestamps", 't', NULL, 0, "In batch mode, hold commands "
+				"back until their timestamp"},
+		{"threshold", 'T', "DELTA", 0, "Suppress color changes that "
+				"are perceptually smaller than DELTA (0-255), -1 "
+				"disables the suppression"},
 		{"verbose", 'v', NULL, 0, "Be verbose"},
 		{0}
 };
@@ -204,12 +2165,15 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			return EINVAL;
 		}
 		break;
+	case 'c':
+		options.capture = arg;
+		break;
 	case 'd':
 		options.device = arg;
 		break;
 	case 'r':
-		ret = atoi(arg);
-		if (ret > 255 || ret < 1) {
+		ret = strcmp(arg, "auto") == 0 ? 0 : atoi(arg);
+		if (ret > 255 || ret < 0) {
 			fputs("licor: number of repetitions out of range\n",
 					stderr);
 			return EINVAL;
@@ -224,6 +2188,59 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 		}
 		options.lamp.seq = (uint8_t)ret;
 		break;
+	case 't':
+		options.timestamps = 1;
+		break;
+	case 'g':
+		options.gdo_chip = strtok(arg, ",");
+		arg = strtok(NULL, ",");
+		if (options.gdo_chip == NULL || arg == NULL) {
+			fputs("licor: GPIO line must be given as CHIP,LINE\n",
+					stderr);
+			return EINVAL;
+		}
+		options.gdo_line = (unsigned int)atoi(arg);
+		break;
+	case 'R':
+		if (sscanf(arg, "%d,%d", &options.priority, &options.cpu) < 1
+				|| options.priority < 1
+				|| options.priority > 99) {
+			fputs("licor: real-time priority out of range\n",
+					stderr);
+			return EINVAL;
+		}
+		break;
+	case 'C':
+		ret = atoi(arg);
+		if (ret < 1) {
+			fputs("licor: confirmation window out of range\n",
+					stderr);
+			return EINVAL;
+		}
+		options.confirm = ret;
+		break;
+	case 'y':
+		ret = atoi(arg);
+		if (ret < 1) {
+			fputs("licor: sync time out of range\n", stderr);
+			return EINVAL;
+		}
+		options.sync = ret;
+		break;
+	case 'w':
+		options.www = arg;
+		break;
+	case 'u':
+		options.ring = arg;
+		break;
+	case 'T':
+		ret = atoi(arg);
+		if (ret > 255 || ret < -1) {
+			fputs("licor: threshold out of range\n", stderr);
+			return EINVAL;
+		}
+		lc_suppress_threshold = ret;
+		break;
 	case 'v':
 		options.verbose = 1;
 		break;
@@ -244,6 +2261,138 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 				return EINVAL;
 			}
 		}
+		else if (options.command == C_AMBIENT && state->arg_num == 1) {
+			ret = parse_geometry(arg, &options.width,
+					&options.height);
+			if (ret != 0) {
+				fputs("licor: invalid geometry given\n",
+						stderr);
+				return EINVAL;
+			}
+		}
+		else if (options.command == C_SWEEP && state->arg_num == 1) {
+			ret = atoi(arg);
+			if (ret > 255 || ret < 0) {
+				fputs("licor: channel out of range\n", stderr);
+				return EINVAL;
+			}
+			options.first = (uint8_t)ret;
+			options.n_channels = 256 - ret;
+		}
+		else if (options.command == C_SWEEP && state->arg_num == 2) {
+			ret = atoi(arg);
+			if (ret < 1 || ret > 256 - options.first) {
+				fputs("licor: number of channels out of range\n",
+						stderr);
+				return EINVAL;
+			}
+			options.n_channels = (unsigned int)ret;
+		}
+		else if (options.command == C_SCAN && state->arg_num == 1) {
+			ret = atoi(arg);
+			if (ret < 1 || ret > 255) {
+				fputs("licor: scan duration out of range\n",
+						stderr);
+				return EINVAL;
+			}
+			options.seconds = (uint8_t)ret;
+		}
+		else if (options.command == C_VERIFY && state->arg_num == 1
+				&& strcmp(arg, "repair") == 0) {
+			options.repair = 1;
+		}
+		else if ((options.command == C_LATENCY
+				|| options.command == C_BENCH)
+				&& state->arg_num == 1) {
+			ret = atoi(arg);
+			if (ret < 1) {
+				fputs("licor: number of frames out of range\n",
+						stderr);
+				return EINVAL;
+			}
+			options.n_samples = (unsigned int)ret;
+		}
+		else if (options.command == C_FARM && state->arg_num == 1) {
+			ret = atoi(arg);
+			if (ret < 1) {
+				fputs("licor: number of rounds out of range\n",
+						stderr);
+				return EINVAL;
+			}
+			options.rounds = (unsigned int)ret;
+		}
+		else if (options.command == C_REPLAY && state->arg_num == 1) {
+			options.input = arg;
+		}
+		else if (options.command == C_REPLAY && state->arg_num == 2) {
+			options.speed = strcmp(arg, "max") == 0 ? 0 : atof(arg);
+			if (options.speed < 0 || (options.speed == 0
+					&& strcmp(arg, "max") != 0)) {
+				fputs("licor: invalid speed given\n", stderr);
+				return EINVAL;
+			}
+		}
+		else if ((options.command == C_BATCH
+				|| options.command == C_PUSH)
+				&& state->arg_num == 1) {
+			options.input = arg;
+		}
+		else if (options.command == C_SERVE && state->arg_num == 1) {
+			ret = atoi(arg);
+			if (ret > 65535 || ret < 1) {
+				fputs("licor: port out of range\n", stderr);
+				return EINVAL;
+			}
+			options.port = (uint16_t)ret;
+		}
+		else if (options.command == C_AMBIENT && state->arg_num == 2) {
+			options.input = arg;
+		}
+		else if (options.command == C_FADE && (state->arg_num == 1
+				|| state->arg_num == 2)) {
+			ret = parse_color(arg, state->arg_num == 1
+					? &options.from : &options.color);
+			if (ret != 0) {
+				fputs("licor: invalid color given\n", stderr);
+				return EINVAL;
+			}
+		}
+		else if ((options.command == C_SCENE
+				|| options.command == C_SAVE)
+				&& state->arg_num == 1) {
+			options.input = arg;
+		}
+		else if ((options.command == C_SCENE
+				|| options.command == C_SAVE)
+				&& state->arg_num == 2) {
+			options.scene = arg;
+		}
+		else if (options.command == C_SAVE && state->arg_num == 3) {
+			ret = parse_command(arg);
+			if (ret != C_ON && ret != C_OFF) {
+				fputs("licor: state must be on or off\n",
+						stderr);
+				return EINVAL;
+			}
+			options.state = ret == C_ON ? LC_STATE_ON
+					: LC_STATE_OFF;
+		}
+		else if (options.command == C_SAVE && state->arg_num == 4
+				&& options.state == LC_STATE_ON) {
+			ret = parse_color(arg, &options.color);
+			if (ret != 0) {
+				fputs("licor: invalid color given\n", stderr);
+				return EINVAL;
+			}
+		}
+		else if (options.command == C_FADE && state->arg_num == 3) {
+			ret = atoi(arg);
+			if (ret < 0) {
+				fputs("licor: duration out of range\n", stderr);
+				return EINVAL;
+			}
+			options.duration = (uint32_t)ret;
+		}
 		else {
 			fprintf(stderr, "licor: unexpected argument `%s`\n",
 					arg);
@@ -260,6 +2409,30 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			fputs("licor: missing argument <color>\n", stderr);
 			return EINVAL;
 		}
+		else if (state->arg_num == 1 && options.command == C_AMBIENT) {
+			fputs("licor: missing argument <geometry>\n", stderr);
+			return EINVAL;
+		}
+		else if (state->arg_num < 2 && options.command == C_REPLAY) {
+			fputs("licor: missing argument <file>\n", stderr);
+			return EINVAL;
+		}
+		else if (state->arg_num < 3 && options.command == C_SCENE) {
+			fputs("licor: scene needs <file> <name>\n", stderr);
+			return EINVAL;
+		}
+		else if (options.command == C_SAVE && (state->arg_num < 4
+				|| (state->arg_num < 5
+				&& options.state == LC_STATE_ON))) {
+			fputs("licor: save needs <file> <name> on <color> "
+					"or <file> <name> off\n", stderr);
+			return EINVAL;
+		}
+		else if (state->arg_num < 4 && options.command == C_FADE) {
+			fputs("licor: fade needs <color> <color> <ms>\n",
+					stderr);
+			return EINVAL;
+		}
 		break;
 
 	default:
@@ -271,23 +2444,54 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 
 static struct argp argp = {
 		argp_options, &parse_opt,
-		"<command> [<color>]",
+		"<command> [<arguments>]",
 		"A simple command-line interface for liblicor. You can use this"
 		" to control Philips Living Colors lamps.\n\n"
 		"<command> can be one of\n"
 		"\ton <color>\t\tTurn the lamp on\n"
 		"\toff\t\t\tTurn the lamp off\n"
 		"\tset <color>\t\tSet the color of the lamp\n"
-		"\tscan\t\t\tScan for lamp addresses\n"
+		"\tscan [<s>]\t\tScan for lamp addresses for <s> seconds\n"
+		"\tambient <geometry> [<file>]\n"
+		"\t\t\t\tDrive the lamp with the average color of raw\n"
+		"\t\t\t\tRGB24 frames read from <file> or stdin\n"
+		"\tfade <color> <color> <ms>\n"
+		"\t\t\t\tFade the lamp from one color to another\n"
+		"\tscene <file> <name>\tActivate a scene from a scene store\n"
+		"\tsave <file> <name> on <color> | off\n"
+		"\t\t\t\tAdd the lamp to a scene in a scene store\n"
+		"\tbatch [<file>]\t\tExecute the commands in <file> or stdin,\n"
+		"\t\t\t\tone per line as <address> on|off|set\n"
+		"\t\t\t\t[<color>] [@<ms since start>]\n"
+		"\tserve [<port>]\t\tServe the web interface and accept commands\n"
+		"\t\t\t\tas in batch mode through WebSockets and\n"
+		"\t\t\t\tthe ring of -u\n"
+		"\tpush [<file>]\t\tSubmit commands as in batch mode to the ring\n"
+		"\t\t\t\tof `serve`, see -u\n"
+		"\treplay <file> [<speed>]\tSend the packets captured in <file> again,\n"
+		"\t\t\t\t<speed> times as fast or `max`\n"
+		"\tsweep [<first> [<n>]]\tMeasure the signal strength on <n> channels,\n"
+		"\t\t\t\tthe strongest of -r sweeps is shown\n"
+		"\tverify [repair]\t\tCheck the configuration of the CC2500 and\n"
+		"\t\t\t\toptionally rewrite what differs\n"
+		"\tbench [<n>]\t\tMeasure the bit rate of <n> SPI bursts\n"
+		"\tfarm [<rounds>]\t\tSend <rounds> updates to every lamp of the\n"
+		"\t\t\t\tfarm in batches and report their delivery\n"
+		"\tlatency [<n>]\t\tSend <n> frames and report the jitter from\n"
+		"\t\t\t\twake-up to STX, see -R\n"
 		"\n"
 		"<color> is a color and must be given as\n"
-		"\tH,S,V"
+		"\tH,S,V\n"
+		"\n"
+		"<geometry> is the size of the frames and must be given as\n"
+		"\tWIDTHxHEIGHT"
 };
 
 int main(int argc, char *argv[])
 {
-	int ret, result;
+	int ret, result, status;
 	FILE *sts_seqno_f;
+	struct lc_handle handle;
 
 	result = 1;
 	sts_seqno_f = NULL;
@@ -296,35 +2500,74 @@ int main(int argc, char *argv[])
 	if (ret != 0)
 		return 1;
 
-	ret = access(STS_BASE_DIR, F_OK);
-	if (ret != 0) {
-		perror("error: status directory does not exist");
-		goto finish;
-	}
+	/*
+	 * Editing a scene store does not need the radio.
+	 */
+	if (options.command == C_SAVE)
+		return run_save() == 0 ? 0 : 1;
 
-	ret = access(STS_BASE_DIR, R_OK);
-	if (ret != 0) {
-		fputs("error: cannot read from status directory", stderr);
-		goto finish;
-	}
+	/* neither does feeding the ring of a running `serve` */
+	if (options.command == C_PUSH)
+		return run_push() == 0 ? 0 : 1;
 
+	/*
+	 * The sequence number file is merely a hint, the sequence numbers of
+	 * the original remote are picked up from the air as well, see -y.
+	 */
 	sts_seqno_f = fopen(STS_BASE_DIR "/" STS_SEQNO, "r+");
 	if (sts_seqno_f == NULL) {
-		perror("error: cannot open sequence number file");
-		goto finish;
+		if (options.verbose)
+			perror("warning: cannot open sequence number file");
 	}
-
-	ret = fread(&options.lamp.seq, sizeof options.lamp.seq, 1, sts_seqno_f);
-	if (ret != 1) {
+	else if (fread(&options.lamp.seq, sizeof options.lamp.seq, 1,
+				sts_seqno_f) != 1) {
 		perror("warning: cannot read from sequence number file, "
 				"assuming 0");
 		options.lamp.seq = 0;
 	}
 
-	ret = lc_init();
+	if (options.capture != NULL) {
+		ret = capture_open(options.capture);
+		if (ret != 0)
+			goto finish;
+		lc_tap = capture_write;
+	}
+
+	/* the benchmark measures the SPI on its own, the CC2500 may be absent */
+	if (options.command == C_BENCH)
+		ret = spi_init();
+	else
+		ret = lc_init();
 	if (ret != 0)
 		goto finish;
 
+	if (options.priority > 0) {
+		ret = rt_enter(options.priority, options.cpu);
+		if (ret != 0) {
+			perror("error: cannot enter real-time profile");
+			goto finish;
+		}
+	}
+
+	lc_clock = clock_us;
+
+	if (options.gdo_chip != NULL) {
+		gdo_fd = gpio_request_edge(options.gdo_chip,
+				options.gdo_line);
+		if (gdo_fd < 0) {
+			perror("error: cannot request GDO2 line");
+			goto finish;
+		}
+		lc_wait_gdo = wait_gdo;
+	}
+
+	if (options.confirm > 0) {
+		lc_confirm_window = options.confirm;
+		lc_confirm_mode(1);
+		if (is_emu())
+			emu_on_tx = emu_answer;
+	}
+
 	*lc_color = options.color;
 
 	if (options.verbose) {
@@ -347,45 +2590,117 @@ int main(int argc, char *argv[])
 				lc_color->saturation, lc_color->value);
 	}
 
+	lc_handle_init(&handle, &options.lamp);
+
+	status = 0;
+	switch (options.command) {
+	case C_ON:
+	case C_OFF:
+	case C_SET:
+	case C_AMBIENT:
+	case C_FADE:
+		sync_lamps(&handle, 1);
+		options.lamp.seq = handle.packet.sequence_number;
+		break;
+	default:
+		break;
+	}
+
 	switch (options.command) {
 	case C_ON:
-		for (register int i = 0; i < options.repetitions; i++)
-			lc_on(&options.lamp);
+		if (lc_handle_on(&handle))
+			deliver(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
 		break;
 	case C_OFF:
-		for (register int i = 0; i < options.repetitions; i++)
-			lc_off(&options.lamp);
-		options.lamp.seq = 0;
+		if (lc_handle_off(&handle))
+			deliver(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
 		break;
 	case C_SET:
-		for (register int i = 0; i < options.repetitions; i++)
-			lc_set_color(&options.lamp, NULL);
+		if (lc_handle_set_color(&handle, NULL))
+			deliver(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
+		break;
+	case C_AMBIENT:
+		status = run_ambient(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
+		break;
+	case C_FADE:
+		status = run_fade(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
+		break;
+	case C_SCENE:
+		status = run_scene();
+		break;
+	case C_BATCH:
+		status = run_batch();
+		break;
+	case C_SERVE:
+		status = run_serve();
+		break;
+	case C_REPLAY:
+		status = run_replay();
+		break;
+	case C_SWEEP:
+		status = run_sweep();
+		break;
+	case C_BENCH:
+		status = run_bench();
+		break;
+	case C_FARM:
+		status = run_farm();
+		break;
+	case C_VERIFY:
+		if (check_radio(options.repair) == 0)
+			puts("configuration ok");
+		break;
+	case C_LATENCY:
+		status = run_latency(&handle);
+		options.lamp.seq = handle.packet.sequence_number;
 		break;
 	case C_SCAN:
 		puts("licor will now scan for addresses. Use your original "
 				"remote intensively for the next few seconds.\n");
-		fputs("error: Sorry, this is not yet implemented.\n", stderr);
+		status = run_scan();
 		break;
 	default:
 		break;
 	}
 
-	ret = fseek(sts_seqno_f, 0, SEEK_SET);
-	assert (ret == 0);
+	if (options.verbose)
+		printf("%" PRIu32 " frames sent, %" PRIu32 " suppressed (%"
+				PRIu32 " ms of air time saved), %" PRIu32
+				" sequence numbers synced\n",
+				lc_stats.sent, lc_stats.suppressed,
+				lc_stats.suppressed * LC_FRAME_PERIOD_US
+					/ 1000, lc_stats.synced);
 
-	ret = fwrite(&options.lamp.seq, sizeof options.lamp.seq, 1, sts_seqno_f);
-	if (ret != 1) {
-		perror("warning: cannot write to sequence number file");
+	if (is_farm()) {
+		farm_report(stdout, options.verbose);
+		farm_close();
 	}
 
-	ret = fclose(sts_seqno_f);
-	sts_seqno_f = NULL;
-	if (ret == EOF) {
-		perror("Error closing sequence number file");
-		goto finish;
+	if (sts_seqno_f != NULL) {
+		ret = fseek(sts_seqno_f, 0, SEEK_SET);
+		assert (ret == 0);
+
+		ret = fwrite(&options.lamp.seq, sizeof options.lamp.seq, 1,
+				sts_seqno_f);
+		if (ret != 1) {
+			perror("warning: cannot write to sequence number "
+					"file");
+		}
+
+		ret = fclose(sts_seqno_f);
+		sts_seqno_f = NULL;
+		if (ret == EOF) {
+			perror("Error closing sequence number file");
+			goto finish;
+		}
 	}
 
-	result = 0;
+	result = status == 0 ? 0 : 1;
 
 finish:
 
@@ -393,5 +2708,10 @@ finish:
 		fclose(sts_seqno_f);
 	}
 
+	capture_close();
+
+	if (gdo_fd >= 0)
+		close(gdo_fd);
+
 	return result;
 }
@@ -0,0 +1,393 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ring.h"
+
+/**
+ * Identifies the layout of the shared memory.
+ */
+#define RING_MAGIC	0x6C637231u	/* "lcr1" */
+
+/**
+ * The size of a cache line, which the producers and the consumer do not share.
+ */
+#define CACHE_LINE	64
+
+/*
+ * A slot is free for the producer that claims position `pos` if its sequence
+ * number is `pos`, and holds a command for the consumer once it is `pos + 1`.
+ * After taking the command, the consumer hands the slot on to the position one
+ * lap ahead.
+ */
+struct ring_slot {
+	uint32_t seq;
+	struct ring_cmnd cmnd;
+};
+
+/*
+ * Anything in here may be scribbled over by a producer, so the consumer keeps
+ * its own copy of `n_slots` and the position it takes from in `struct ring`.
+ */
+struct ring_shm {
+	uint32_t magic;
+	uint32_t n_slots;
+	uint32_t head __attribute__((aligned(CACHE_LINE)));
+					/**< The next position to claim. */
+	uint32_t idle __attribute__((aligned(CACHE_LINE)));
+					/**< Whether the consumer waits. */
+	struct ring_slot slot[] __attribute__((aligned(CACHE_LINE)));
+};
+
+/* the layout is shared between processes, and the atomics must be aligned */
+__extension__ _Static_assert(offsetof(struct ring_slot, seq) == 0
+		&& sizeof(struct ring_slot) % sizeof(uint32_t) == 0,
+		"ring slots are not aligned");
+__extension__ _Static_assert(offsetof(struct ring_shm, head) == CACHE_LINE
+		&& offsetof(struct ring_shm, idle) == 2 * CACHE_LINE
+		&& offsetof(struct ring_shm, slot) == 3 * CACHE_LINE,
+		"unexpected layout of the shared memory");
+
+static size_t shm_size(uint32_t n_slots)
+{
+	return sizeof(struct ring_shm) + n_slots * sizeof(struct ring_slot);
+}
+
+int ring_create(struct ring *r, uint32_t n_slots)
+{
+	uint32_t i;
+
+	if (n_slots == 0 || (n_slots & (n_slots - 1)) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	r->size = shm_size(n_slots);
+	r->shm = MAP_FAILED;
+	r->doorbell = -1;
+
+	r->memfd = memfd_create("licor-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (r->memfd < 0)
+		return -1;
+
+	/* producers must not be able to pull the memory from under us */
+	if (ftruncate(r->memfd, r->size) != 0 || fcntl(r->memfd, F_ADD_SEALS,
+				F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+			!= 0)
+		goto fail;
+
+	r->shm = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			r->memfd, 0);
+	if (r->shm == MAP_FAILED)
+		goto fail;
+
+	r->doorbell = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (r->doorbell < 0)
+		goto fail;
+
+	r->shm->magic = RING_MAGIC;
+	r->shm->n_slots = n_slots;
+	for (i = 0; i < n_slots; i++)
+		r->shm->slot[i].seq = i;
+	r->n_slots = n_slots;
+	r->tail = 0;
+
+	return 0;
+
+fail:
+	ring_close(r);
+	return -1;
+}
+
+int ring_listen(const char *path)
+{
+	struct sockaddr_un sa = {0};
+	int fd;
+
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0
+			|| listen(fd, 8) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ring_offer(int lfd, const struct ring *r)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+	} ctrl;
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	int fd, fds[2], ret;
+	uint32_t magic;
+
+	fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	magic = RING_MAGIC;
+	iov.iov_base = &magic;
+	iov.iov_len = sizeof(magic);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	fds[0] = r->memfd;
+	fds[1] = r->doorbell;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	ret = sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(magic) ? 0 : -1;
+	close(fd);
+
+	return ret;
+}
+
+int ring_connect(const char *path, struct ring *r)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+	} ctrl;
+	struct sockaddr_un sa = {0};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct stat st;
+	uint32_t magic;
+	int fd, fds[2];
+	ssize_t n;
+
+	r->shm = MAP_FAILED;
+	r->memfd = -1;
+	r->doorbell = -1;
+
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	iov.iov_base = &magic;
+	iov.iov_len = sizeof(magic);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+	close(fd);
+	if (n < 0)
+		return -1;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (n != sizeof(magic) || magic != RING_MAGIC || cmsg == NULL
+			|| cmsg->cmsg_type != SCM_RIGHTS
+			|| cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+		errno = EPROTO;
+		return -1;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	r->memfd = fds[0];
+	r->doorbell = fds[1];
+
+	/* trust the size of the memfd only as far as it is sealed */
+	if (fstat(r->memfd, &st) != 0)
+		goto fail;
+	if (fcntl(r->memfd, F_GET_SEALS) != (F_SEAL_SHRINK | F_SEAL_GROW
+				| F_SEAL_SEAL)
+			|| (size_t)st.st_size < sizeof(struct ring_shm)) {
+		errno = EPROTO;
+		goto fail;
+	}
+
+	r->size = st.st_size;
+	r->shm = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			r->memfd, 0);
+	if (r->shm == MAP_FAILED)
+		goto fail;
+
+	/* read once, as other producers could change it in between */
+	r->n_slots = __atomic_load_n(&r->shm->n_slots, __ATOMIC_RELAXED);
+	if (r->shm->magic != RING_MAGIC || r->n_slots == 0
+			|| (r->n_slots & (r->n_slots - 1)) != 0
+			|| shm_size(r->n_slots) > r->size) {
+		errno = EPROTO;
+		goto fail;
+	}
+	r->tail = 0;
+
+	return 0;
+
+fail:
+	ring_close(r);
+	return -1;
+}
+
+int ring_submit(struct ring *r, const struct ring_cmnd *c)
+{
+	struct ring_shm *shm;
+	struct ring_slot *s;
+	uint32_t pos, seq, mask;
+	uint64_t one;
+	int32_t diff;
+
+	shm = r->shm;
+	mask = r->n_slots - 1;
+
+	pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+	for (;;) {
+		s = &shm->slot[pos & mask];
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		diff = (int32_t)(seq - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&shm->head, &pos,
+						pos + 1, 1, __ATOMIC_RELAXED,
+						__ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0) {
+			/* the slot still holds the command of the last lap */
+			errno = EAGAIN;
+			return -1;
+		}
+		else {
+			pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	s->cmnd = *c;
+
+	/*
+	 * Publishing the command and checking for an idle consumer must not be
+	 * reordered, as ring_idle() does the same the other way round: either
+	 * the consumer sees the command or the producer sees it idle.
+	 */
+	__atomic_store_n(&s->seq, pos + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&shm->idle, __ATOMIC_SEQ_CST)
+			&& __atomic_exchange_n(&shm->idle, 0,
+				__ATOMIC_SEQ_CST)) {
+		one = 1;
+		write(r->doorbell, &one, sizeof(one));
+	}
+
+	return 0;
+}
+
+/*
+ * Returns whether the slot at the tail holds a command.
+ */
+static int ready(const struct ring *r, int order)
+{
+	return __atomic_load_n(&r->shm->slot[r->tail & (r->n_slots - 1)].seq,
+			order) == r->tail + 1;
+}
+
+int ring_take(struct ring *r, struct ring_cmnd *c)
+{
+	struct ring_slot *s;
+
+	if (!ready(r, __ATOMIC_ACQUIRE))
+		return 0;
+
+	s = &r->shm->slot[r->tail & (r->n_slots - 1)];
+	*c = s->cmnd;
+	__atomic_store_n(&s->seq, r->tail + r->n_slots, __ATOMIC_RELEASE);
+	r->tail++;
+
+	return 1;
+}
+
+int ring_idle(struct ring *r)
+{
+	__atomic_store_n(&r->shm->idle, 1, __ATOMIC_SEQ_CST);
+	if (!ready(r, __ATOMIC_SEQ_CST))
+		return 1;
+
+	__atomic_store_n(&r->shm->idle, 0, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+void ring_ack(struct ring *r)
+{
+	uint64_t n;
+
+	__atomic_store_n(&r->shm->idle, 0, __ATOMIC_RELAXED);
+	read(r->doorbell, &n, sizeof(n));
+}
+
+void ring_close(struct ring *r)
+{
+	if (r->shm != MAP_FAILED && r->shm != NULL)
+		munmap(r->shm, r->size);
+	if (r->memfd >= 0)
+		close(r->memfd);
+	if (r->doorbell >= 0)
+		close(r->doorbell);
+
+	r->shm = NULL;
+	r->memfd = -1;
+	r->doorbell = -1;
+}
@@ -0,0 +1,138 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+#include <liblicor.h>
+
+/**
+ * The commands of the records, with the values of the command line.
+ */
+enum RING_COMMANDS {
+	RING_ON = 0,
+	RING_OFF = 1,
+	RING_SET = 2
+};
+
+/**
+ * A command for a lamp as it is passed through the ring.
+ */
+struct ring_cmnd {
+	uint8_t addr[9];	/**< The address of the lamp. */
+	uint8_t command;	/**< One of `RING_COMMANDS`. */
+	struct color color;	/**< The color for RING_ON and RING_SET. */
+};
+
+struct ring_shm;
+
+/**
+ * A bounded lock-free ring of commands in shared memory, which any number of
+ * processes feed and the one that owns the radio drains.
+ *
+ * The memory is a sealed memfd and the doorbell an eventfd, which are passed
+ * to the producers over a Unix socket. A producer only signals the doorbell if
+ * the consumer has declared itself idle with ring_idle(), so that submitting a
+ * command while the consumer is busy does not take a system call at all.
+ *
+ * Commands are taken in the order in which their slots have been claimed, so a
+ * producer that is killed between claiming a slot and filling it stalls the
+ * ring for good.
+ */
+struct ring {
+	struct ring_shm *shm;	/**< The mapping of the memfd. */
+	size_t size;		/**< The size of the mapping. */
+	uint32_t n_slots;	/**< The number of slots, as validated. */
+	uint32_t tail;		/**< The next position to take, consumer only. */
+	int memfd;
+	int doorbell;		/**< The eventfd. */
+};
+
+/**
+ * Creates a ring with `n_slots` slots, which must be a power of two, for the
+ * consumer.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set.
+ */
+int ring_create(struct ring *r, uint32_t n_slots);
+
+/**
+ * Creates a Unix socket at `path` on which ring_offer() hands out a ring. A
+ * file left at `path` by a previous run is replaced.
+ *
+ * \return	The listening socket, or -1 on error with `errno` set.
+ */
+int ring_listen(const char *path);
+
+/**
+ * Accepts a connection on the socket `lfd` from ring_listen() and passes the
+ * memfd and the eventfd of `r` to it.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set.
+ */
+int ring_offer(int lfd, const struct ring *r);
+
+/**
+ * Connects to the socket at `path` and maps the ring offered there, for a
+ * producer.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set.
+ */
+int ring_connect(const char *path, struct ring *r);
+
+/**
+ * Submits a command, which is safe to do from any number of producers at the
+ * same time.
+ *
+ * \return	0 on success, -1 with `errno` set to EAGAIN if the ring is full.
+ */
+int ring_submit(struct ring *r, const struct ring_cmnd *c);
+
+/**
+ * Takes the oldest command out of the ring, for the consumer only.
+ *
+ * \return	1 if a command has been taken, 0 if the ring is empty.
+ */
+int ring_take(struct ring *r, struct ring_cmnd *c);
+
+/**
+ * Declares the consumer idle, i.e. about to wait for the doorbell, unless
+ * commands have been submitted meanwhile.
+ *
+ * \return	1 if the ring is empty and the consumer may wait, 0 if it has to
+ *		drain the ring first.
+ */
+int ring_idle(struct ring *r);
+
+/**
+ * Declares the consumer busy again after it has waited, and resets the
+ * doorbell in case it has been rung.
+ */
+void ring_ack(struct ring *r);
+
+/**
+ * Unmaps the ring and closes its file descriptors.
+ */
+void ring_close(struct ring *r);
+
+#endif	/* RING_H_ */
@@ -0,0 +1,108 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+/*
+ * Touches the stack down to RT_STACK_SIZE below the caller, so that it is
+ * mapped, and locked, before the time-critical part starts.
+ */
+static void prefault_stack(void)
+{
+	volatile uint8_t stack[RT_STACK_SIZE];
+
+	memset((uint8_t *)stack, 0, sizeof(stack));
+}
+
+int rt_enter(int priority, int cpu)
+{
+	struct sched_param param = {0};
+	cpu_set_t set;
+
+	if (cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) != 0)
+			return -1;
+	}
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		return -1;
+
+	prefault_stack();
+
+	param.sched_priority = priority;
+	if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+		return -1;
+
+	return 0;
+}
+
+void rt_prefault(void *buf, size_t n)
+{
+	volatile uint8_t *p;
+	size_t page, i;
+
+	page = sysconf(_SC_PAGESIZE);
+	p = buf;
+
+	for (i = 0; i < n; i += page)
+		p[i] = p[i];
+	if (n > 0)
+		p[n - 1] = p[n - 1];
+}
+
+static int compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * The sample below which a share of `per_mille` of the samples lie.
+ */
+static uint64_t percentile(const uint64_t *s, size_t n, unsigned int per_mille)
+{
+	return s[(n - 1) * per_mille / 1000];
+}
+
+void rt_latency(uint64_t *samples, size_t n, struct rt_latency *l)
+{
+	memset(l, 0, sizeof(*l));
+	if (n == 0)
+		return;
+
+	qsort(samples, n, sizeof(*samples), compare);
+
+	l->min = samples[0];
+	l->p50 = percentile(samples, n, 500);
+	l->p90 = percentile(samples, n, 900);
+	l->p99 = percentile(samples, n, 990);
+	l->p999 = percentile(samples, n, 999);
+	l->max = samples[n - 1];
+}
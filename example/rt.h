@@ -0,0 +1,69 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RT_H_
+#define RT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The amount of stack that is touched in advance by rt_enter(), in bytes.
+ */
+#define RT_STACK_SIZE	(256 * 1024)
+
+/**
+ * Puts the calling process into a real-time profile: it is scheduled with
+ * SCHED_FIFO at `priority`, pinned to `cpu` unless that is negative, and all
+ * of its memory is locked, including the stack that is pre-faulted here.
+ *
+ * Memory that is allocated afterwards is locked as well, but should rather be
+ * allocated before and touched with rt_prefault(), so that the first access
+ * does not fault.
+ *
+ * \return	Returns 0 on success, -1 otherwise. The `errno` will be set
+ *		in case of an error, usually EPERM.
+ */
+int rt_enter(int priority, int cpu);
+
+/**
+ * Touches every page of `n` bytes at `buf`.
+ */
+void rt_prefault(void *buf, size_t n);
+
+/**
+ * Summary of a latency distribution, in nanoseconds.
+ */
+struct rt_latency {
+	uint64_t min;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+/**
+ * Computes the distribution of `n` latency samples, which are sorted in place.
+ */
+void rt_latency(uint64_t *samples, size_t n, struct rt_latency *l);
+
+#endif	/* RT_H_ */
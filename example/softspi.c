@@ -0,0 +1,296 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "softspi.h"
+
+/*
+ * The lines in the order of the line request, as bits of the line values.
+ */
+enum {
+	SCLK = 1 << 0,
+	MOSI = 1 << 1,
+	CSN = 1 << 2,
+	MISO = 1 << 3
+};
+
+/**
+ * The number of writes that are timed to calibrate the clock.
+ */
+#define CALIBRATION_ROUNDS	1024
+
+/**
+ * The number of times MISO is polled for CHIP_RDYn before giving up.
+ */
+#define READY_POLLS		1000
+
+struct softspi_stats softspi_stats;
+
+static struct {
+	int fd;			/**< The line request, or -1 for fake lines. */
+	uint64_t lines;		/**< The state of the fake lines. */
+	uint32_t hz;		/**< The clock aimed for. */
+	uint32_t half_ns;	/**< Half a clock period, 0 runs flat out. */
+} ss = {-1, 0, SOFTSPI_DEFAULT_HZ, 0};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*
+ * Busy waits until `t`, as sleeping would take far longer than a clock phase.
+ */
+static void wait_until(uint64_t t)
+{
+	while (now_ns() < t)
+		;
+}
+
+static void delay(uint32_t ns)
+{
+	wait_until(now_ns() + ns);
+}
+
+/*
+ * Sets the output lines in `mask` to `bits` with a single ioctl.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set by the ioctl.
+ */
+static int set_lines(uint64_t mask, uint64_t bits)
+{
+	struct gpio_v2_line_values v;
+
+	softspi_stats.sets++;
+
+	if (ss.fd < 0) {
+		ss.lines = (ss.lines & ~mask) | (bits & mask);
+		return 0;
+	}
+
+	v.mask = mask;
+	v.bits = bits;
+
+	return ioctl(ss.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v) < 0 ? -1 : 0;
+}
+
+/*
+ * \return	The level of MISO, or -1 with `errno` set by the ioctl.
+ */
+static int get_miso(void)
+{
+	struct gpio_v2_line_values v;
+
+	softspi_stats.gets++;
+
+	if (ss.fd < 0)
+		return 0;
+
+	v.mask = MISO;
+	v.bits = 0;
+	if (ioctl(ss.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &v) < 0)
+		return -1;
+
+	return (v.bits & MISO) != 0;
+}
+
+static int request_lines(const char *chip, const unsigned int offsets[4])
+{
+	struct gpio_v2_line_request req;
+	int fd, ret, i;
+
+	fd = open(chip, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	for (i = 0; i < 4; i++)
+		req.offsets[i] = offsets[i];
+	req.num_lines = 4;
+	strncpy(req.consumer, "licor", sizeof(req.consumer) - 1);
+
+	/* all lines are outputs, CSn starts high, apart from MISO */
+	req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+	req.config.num_attrs = 2;
+	req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+	req.config.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_INPUT;
+	req.config.attrs[0].mask = MISO;
+	req.config.attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+	req.config.attrs[1].attr.values = CSN;
+	req.config.attrs[1].mask = SCLK | MOSI | CSN;
+
+	ret = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req);
+	close(fd);
+	if (ret < 0)
+		return -1;
+
+	return req.fd;
+}
+
+/*
+ * Times the line accesses of a clock period, i.e. two writes and a read. If
+ * they take longer than a period of the clock aimed for, there is no point in
+ * pacing the clock and the lines are driven as fast as possible.
+ */
+static void calibrate(void)
+{
+	uint64_t t, period;
+	unsigned int i;
+
+	t = now_ns();
+	for (i = 0; i < CALIBRATION_ROUNDS; i++) {
+		set_lines(SCLK, 0);
+		get_miso();
+		set_lines(SCLK, 0);
+	}
+	t = (now_ns() - t) / CALIBRATION_ROUNDS;
+
+	period = 1000000000u / (uint64_t)ss.hz;
+	ss.half_ns = period > t ? period / 2 : 0;
+
+	memset(&softspi_stats, 0, sizeof(softspi_stats));
+}
+
+int softspi_init(const char *spec)
+{
+	char chip[64];
+	unsigned int offsets[4];
+	unsigned long hz;
+	int n;
+
+	hz = SOFTSPI_DEFAULT_HZ;
+	if (strncmp(spec, "fake", 4) == 0) {
+		n = sscanf(spec, "fake,%lu", &hz);
+		ss.fd = -1;
+	}
+	else {
+		n = sscanf(spec, "%63[^,],%u,%u,%u,%u,%lu", chip, &offsets[0],
+				&offsets[1], &offsets[3], &offsets[2], &hz);
+		if (n < 5) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		/* the request orders the lines as SCLK, MOSI, CSn, MISO */
+		ss.fd = request_lines(chip, offsets);
+		if (ss.fd < 0)
+			return -1;
+	}
+
+	if (hz == 0 || hz > 10000000) {
+		errno = EINVAL;
+		return -1;
+	}
+	ss.hz = hz;
+
+	calibrate();
+
+	/*
+	 * The manual power-on reset: strobe CSn with SCLK high and MOSI low,
+	 * then keep CSn high for at least 40 us. The SRES strobe follows in
+	 * cc2k5_init().
+	 */
+	if (set_lines(SCLK | MOSI | CSN, SCLK | CSN) != 0
+			|| set_lines(CSN, 0) != 0)
+		return -1;
+	delay(1000);
+	if (set_lines(CSN, CSN) != 0)
+		return -1;
+	delay(50000);
+
+	return set_lines(SCLK, 0);
+}
+
+int softspi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	uint8_t *tx, *rx, out, in, bit;
+	unsigned int i;
+	uint64_t t;
+	int miso, err;
+
+	tx = tx_buf;
+	rx = rx_buf;
+
+	/* SO doubles as CHIP_RDYn until the first clock edge */
+	if (set_lines(CSN, 0) != 0)
+		goto fail;
+	for (i = 0; i < READY_POLLS && (miso = get_miso()) != 0; i++) {
+		if (miso < 0)
+			goto fail;
+	}
+
+	/*
+	 * Each clock edge is due half a period after the previous one, so the
+	 * time spent in the ioctls is made up for instead of adding up.
+	 */
+	t = now_ns();
+	for (i = 0; i < n_bytes; i++) {
+		out = tx != NULL ? tx[i] : 0;
+		in = 0;
+
+		for (bit = 0x80; bit != 0; bit >>= 1) {
+			if (set_lines(SCLK | MOSI, out & bit ? MOSI : 0) != 0)
+				goto fail;
+			if (rx != NULL) {
+				miso = get_miso();
+				if (miso < 0)
+					goto fail;
+				in = (in << 1) | miso;
+			}
+			if (ss.half_ns > 0)
+				wait_until(t += ss.half_ns);
+			if (set_lines(SCLK, SCLK) != 0)
+				goto fail;
+			if (ss.half_ns > 0)
+				wait_until(t += ss.half_ns);
+		}
+
+		if (rx != NULL)
+			rx[i] = in;
+	}
+
+	return set_lines(SCLK | CSN, CSN);
+
+fail:
+	/* try to end the transfer, keeping the errno of the failure */
+	err = errno;
+	set_lines(SCLK | CSN, CSN);
+	errno = err;
+
+	return -1;
+}
+
+uint32_t softspi_hz(void)
+{
+	return ss.hz;
+}
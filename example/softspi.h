@@ -0,0 +1,72 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SOFTSPI_H_
+#define SOFTSPI_H_
+
+#include <stdint.h>
+
+/**
+ * The clock that the soft SPI aims for unless another one is given, in Hz.
+ */
+#define SOFTSPI_DEFAULT_HZ	500000
+
+/**
+ * Counters of the soft SPI.
+ */
+struct softspi_stats {
+	unsigned long sets;	/**< Batched writes of the output lines. */
+	unsigned long gets;	/**< Reads of MISO. */
+};
+
+extern struct softspi_stats softspi_stats;
+
+/**
+ * Sets up a bit-banged SPI (mode 0) on the GPIO character device, as specified
+ * by `spec`:
+ *
+ *	CHIP,SCLK,MOSI,MISO,CSN[,HZ]
+ *
+ * with the path of the GPIO chip, the offsets of the four lines on it and the
+ * clock to aim for. The clock lines, MOSI and CSn are requested together, so
+ * that a single ioctl sets all of them. The chip `fake` stands for lines that
+ * only exist in memory, with MISO kept low, to measure the overhead of the
+ * bit-banging itself.
+ *
+ * As the soft SPI owns CSn, the CC2500 is put through its manual power-on
+ * reset sequence here, which spidev does not allow.
+ *
+ * \return	Returns 0 on success, -1 otherwise. The `errno` will be set
+ *		in case of an error.
+ */
+int softspi_init(const char *spec);
+
+/**
+ * Performs an SPI transfer, with the semantics of spi_transfer().
+ */
+int softspi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes);
+
+/**
+ * Returns the clock that the soft SPI aims for, in Hz.
+ */
+uint32_t softspi_hz(void);
+
+#endif	/* SOFTSPI_H_ */
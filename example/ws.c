@@ -0,0 +1,264 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ws.h"
+
+#define WS_GUID	"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+static uint32_t rol(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+/*
+ * Computes the SHA-1 digest of a message of at most 119 bytes, which is
+ * sufficient for the key of the handshake.
+ */
+static void sha1(const uint8_t *msg, size_t len, uint8_t digest[20])
+{
+	uint8_t block[128];
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+			0xC3D2E1F0};
+	uint32_t w[80], a, b, c, d, e, f, k, t;
+	uint64_t bits;
+	size_t n_blocks, i, j;
+
+	memset(block, 0, sizeof(block));
+	memcpy(block, msg, len);
+	block[len] = 0x80;
+
+	n_blocks = len + 9 > 64 ? 2 : 1;
+	bits = (uint64_t)len * 8;
+	for (i = 0; i < 8; i++)
+		block[n_blocks * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+
+	for (j = 0; j < n_blocks; j++) {
+		for (i = 0; i < 16; i++)
+			w[i] = (uint32_t)block[j * 64 + 4 * i] << 24
+					| (uint32_t)block[j * 64 + 4 * i + 1] << 16
+					| (uint32_t)block[j * 64 + 4 * i + 2] << 8
+					| block[j * 64 + 4 * i + 3];
+		for (i = 16; i < 80; i++)
+			w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16],
+					1);
+
+		a = h[0];
+		b = h[1];
+		c = h[2];
+		d = h[3];
+		e = h[4];
+
+		for (i = 0; i < 80; i++) {
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			t = rol(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol(b, 30);
+			b = a;
+			a = t;
+		}
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (i = 0; i < 20; i++)
+		digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+	static const char alphabet[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint32_t v;
+	size_t i;
+
+	for (i = 0; i < len; i += 3) {
+		v = (uint32_t)in[i] << 16;
+		if (i + 1 < len)
+			v |= (uint32_t)in[i + 1] << 8;
+		if (i + 2 < len)
+			v |= in[i + 2];
+
+		*out++ = alphabet[(v >> 18) & 0x3F];
+		*out++ = alphabet[(v >> 12) & 0x3F];
+		*out++ = i + 1 < len ? alphabet[(v >> 6) & 0x3F] : '=';
+		*out++ = i + 2 < len ? alphabet[v & 0x3F] : '=';
+	}
+
+	*out = '\0';
+}
+
+size_t http_header_complete(const char *req, size_t len)
+{
+	size_t i;
+
+	for (i = 3; i < len; i++) {
+		if (req[i - 3] == '\r' && req[i - 2] == '\n'
+				&& req[i - 1] == '\r' && req[i] == '\n')
+			return i + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Finds the value of the header field `name` in `req` and returns its length,
+ * or 0 if there is no such field.
+ */
+static size_t header_field(const char *req, const char *name,
+		const char **value)
+{
+	const char *p;
+	size_t n, len;
+
+	n = strlen(name);
+
+	for (p = strstr(req, "\r\n"); p != NULL; p = strstr(p, "\r\n")) {
+		p += 2;
+		if (strncasecmp(p, name, n) != 0 || p[n] != ':')
+			continue;
+
+		p += n + 1;
+		while (*p == ' ' || *p == '\t')
+			p++;
+
+		len = strcspn(p, "\r\n");
+		while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t'))
+			len--;
+
+		*value = p;
+		return len;
+	}
+
+	return 0;
+}
+
+int ws_handshake(const char *req, char *resp, size_t size)
+{
+	const char *key, *upgrade;
+	char msg[120], accept[29];
+	uint8_t digest[20];
+	size_t n;
+	int ret;
+
+	n = header_field(req, "Upgrade", &upgrade);
+	if (n != 9 || strncasecmp(upgrade, "websocket", 9) != 0)
+		return -1;
+
+	n = header_field(req, "Sec-WebSocket-Key", &key);
+	if (n == 0 || n + sizeof(WS_GUID) > sizeof(msg))
+		return -1;
+
+	memcpy(msg, key, n);
+	memcpy(msg + n, WS_GUID, sizeof(WS_GUID) - 1);
+
+	sha1((const uint8_t *)msg, n + sizeof(WS_GUID) - 1, digest);
+	base64(digest, sizeof(digest), accept);
+
+	ret = snprintf(resp, size, "HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+	if (ret < 0 || (size_t)ret >= size)
+		return -1;
+
+	return 0;
+}
+
+int ws_decode(uint8_t *buf, size_t len, int *opcode, uint8_t **payload,
+		size_t *n)
+{
+	size_t hdr, i;
+	uint64_t plen;
+	uint8_t *mask;
+
+	if (len < 2)
+		return 0;
+
+	/* Fragmented and unmasked frames are not supported. */
+	if ((buf[0] & 0x80) == 0 || (buf[1] & 0x80) == 0)
+		return -1;
+
+	*opcode = buf[0] & 0x0F;
+	plen = buf[1] & 0x7F;
+	hdr = 2;
+
+	if (plen == 126) {
+		if (len < 4)
+			return 0;
+		plen = (uint64_t)buf[2] << 8 | buf[3];
+		hdr = 4;
+	}
+	else if (plen == 127) {
+		/* Nobody sends that much to a lamp. */
+		return -1;
+	}
+
+	if (plen > 0xFFFF || len < hdr + 4 + plen)
+		return plen > 0xFFFF ? -1 : 0;
+
+	mask = buf + hdr;
+	*payload = buf + hdr + 4;
+	*n = (size_t)plen;
+
+	for (i = 0; i < *n; i++)
+		(*payload)[i] ^= mask[i % 4];
+
+	return (int)(hdr + 4 + plen);
+}
+
+size_t ws_encode(uint8_t *buf, int opcode, const void *payload, size_t n)
+{
+	if (n > 125)
+		n = 125;
+
+	buf[0] = 0x80 | (opcode & 0x0F);
+	buf[1] = (uint8_t)n;
+	memcpy(buf + 2, payload, n);
+
+	return n + 2;
+}
@@ -0,0 +1,82 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef WS_H_
+#define WS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum WS_OPCODES {
+	WS_CONTINUATION = 0x0,
+	WS_TEXT = 0x1,
+	WS_BINARY = 0x2,
+	WS_CLOSE = 0x8,
+	WS_PING = 0x9,
+	WS_PONG = 0xA
+};
+
+/**
+ * Checks whether the HTTP request header in `req` is complete, i.e. whether it
+ * has been terminated by an empty line.
+ *
+ * \return	The length of the header including the empty line, or 0 if it is
+ *		not complete yet.
+ */
+size_t http_header_complete(const char *req, size_t len);
+
+/**
+ * Builds the response to a WebSocket opening handshake.
+ *
+ * \param[in]	req	The NUL-terminated HTTP request header.
+ * \param[out]	resp	Will be filled with the NUL-terminated response.
+ * \param[in]	size	The size of `resp`.
+ *
+ * \return	Returns 0 on success, -1 if `req` is not a WebSocket upgrade
+ *		request.
+ */
+int ws_handshake(const char *req, char *resp, size_t size);
+
+/**
+ * Decodes a single, unfragmented frame from a client and unmasks its payload in
+ * place.
+ *
+ * \param[in,out]	buf	The received data.
+ * \param[in]		len	The number of bytes in `buf`.
+ * \param[out]		opcode	One of `WS_OPCODES`.
+ * \param[out]		payload	Points to the payload within `buf`.
+ * \param[out]		n	The length of the payload.
+ *
+ * \return	The number of bytes of the frame, 0 if the frame is not complete
+ *		yet and -1 if the frame is malformed or fragmented.
+ */
+int ws_decode(uint8_t *buf, size_t len, int *opcode, uint8_t **payload,
+		size_t *n);
+
+/**
+ * Encodes an unmasked frame, as sent by a server, of at most 125 bytes payload.
+ *
+ * \return	The length of the frame in `buf`, which needs room for `n` + 2
+ *		bytes.
+ */
+size_t ws_encode(uint8_t *buf, int opcode, const void *payload, size_t n);
+
+#endif	/* WS_H_ */
@@ -0,0 +1,143 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif	/* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "liblicor.h"
+
+void lc_ambient_init(struct lc_ambient *a, struct lc_ambient_lamp *lamps,
+		unsigned int n_lamps, uint16_t width, uint16_t height)
+{
+	unsigned int i;
+
+	a->lamps = lamps;
+	a->n_lamps = n_lamps;
+	a->width = width;
+	a->height = height;
+	a->step = 1;
+	a->smoothing = 2;
+
+	for (i = 0; i < n_lamps; i++) {
+		lamps[i].avg[0] = 0;
+		lamps[i].avg[1] = 0;
+		lamps[i].avg[2] = 0;
+	}
+}
+
+/*
+ * Sums up the red, green and blue components of every `step`th pixel in a row
+ * of `n` pixels.
+ *
+ * This is a scalar loop: the strided loads of interleaved channels keep
+ * compilers from vectorizing it. The sums of a row fit into 32 bits and are
+ * only widened once per row.
+ */
+static unsigned int sum_row(const uint8_t *px, uint16_t n, uint8_t step,
+		uint64_t sum[3])
+{
+	uint32_t r, g, b;
+	unsigned int i, stride, count;
+
+	r = g = b = 0;
+	stride = 3u * step;
+	count = 0;
+
+	for (i = 0; i < 3u * n; i += stride, count++) {
+		r += px[i];
+		g += px[i + 1];
+		b += px[i + 2];
+	}
+
+	sum[0] += r;
+	sum[1] += g;
+	sum[2] += b;
+
+	return count;
+}
+
+unsigned int lc_ambient_feed(struct lc_ambient *a, const uint8_t *frame)
+{
+	struct lc_ambient_lamp *l;
+	const struct lc_region *reg;
+	struct color c;
+	uint64_t sum[3];
+	uint32_t y, count;
+	unsigned int i, k, sent;
+	uint16_t w, h;
+	uint8_t step;
+
+	step = a->step > 0 ? a->step : 1;
+	sent = 0;
+
+	for (i = 0; i < a->n_lamps; i++) {
+		l = &(a->lamps[i]);
+		reg = &(l->region);
+
+		if (reg->x >= a->width || reg->y >= a->height)
+			continue;
+
+		w = reg->w;
+		if (w == 0 || w > a->width - reg->x)
+			w = a->width - reg->x;
+		h = reg->h;
+		if (h == 0 || h > a->height - reg->y)
+			h = a->height - reg->y;
+
+		sum[0] = sum[1] = sum[2] = 0;
+		count = 0;
+
+		/* a row sums up to less than 2^24, but a region can exceed 2^32 */
+		for (y = reg->y; y < (uint32_t)reg->y + h; y += step)
+			count += sum_row(frame + 3u * (y * a->width
+					+ reg->x), w, step, sum);
+
+		/*
+		 * Exponential smoothing in 8.8 fixed point: the new average
+		 * contributes with a weight of 2^-smoothing.
+		 */
+		for (k = 0; k < 3; k++) {
+			int32_t target, delta;
+
+			target = (int32_t)((sum[k] << 8) / count);
+			delta = target - l->avg[k];
+			if (delta < 0)
+				l->avg[k] -= (uint16_t)(-delta >> a->smoothing);
+			else
+				l->avg[k] += (uint16_t)(delta >> a->smoothing);
+		}
+
+		lc_color_from_rgb(&c, l->avg[0] >> 8, l->avg[1] >> 8,
+				l->avg[2] >> 8);
+
+		sent += lc_handle_set_color(l->handle, &c);
+	}
+
+	return sent;
+}
+
+#ifdef __cplusplus
+}
+#endif	/* __cplusplus */
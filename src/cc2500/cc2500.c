@@ -23,10 +23,8 @@
 extern "C" {
 #endif	/* __cplusplus */
 
-#include <errno.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "cc2500.h"
@@ -69,6 +67,65 @@ enum CC2K5_STATUS_BYTE {
  */
 #define CC2K5_PARTNUM		0x80
 
+/**
+ * The size of the RX and TX FIFOs.
+ */
+#define CC2K5_FIFO_SIZE		64
+
+/**
+ * The number of configuration registers, which start at address 0.
+ */
+#define CC2K5_N_CONFIG		(TEST0 + 1)
+
+/**
+ * The number of entries in the PA table.
+ */
+#define CC2K5_PATABLE_SIZE	8
+
+/*
+ * Used for burst transfers, which need a header byte to transmit and room for
+ * the status byte that is received along with it.
+ */
+static uint8_t xfer[CC2K5_FIFO_SIZE + 1];
+
+/*
+ * The values last written to the configuration registers, so that writes which
+ * would not change a register can be skipped. Only registers whose bit is set
+ * in `shadow_known` have been written since the last reset.
+ */
+static uint8_t shadow[CC2K5_N_CONFIG];
+static uint8_t shadow_known[(CC2K5_N_CONFIG + 7) / 8];
+
+/*
+ * The same for the PA table, where a single write always goes to the first
+ * entry and a burst write starts with it.
+ */
+static uint8_t pa_shadow[CC2K5_PATABLE_SIZE];
+static uint8_t pa_known;
+
+static void shadow_update(uint8_t addr, const uint8_t *val, uint8_t n)
+{
+	uint8_t i;
+
+	if (addr == PATABLE) {
+		for (i = 0; i < n && i < CC2K5_PATABLE_SIZE; i++) {
+			pa_shadow[i] = val[i];
+			pa_known |= 1u << i;
+		}
+		return;
+	}
+
+	for (; n > 0 && addr < CC2K5_N_CONFIG; addr++, val++, n--) {
+		shadow[addr] = *val;
+		shadow_known[addr / 8] |= 1u << (addr % 8);
+	}
+}
+
+static int shadow_valid(uint8_t addr)
+{
+	return (shadow_known[addr / 8] & (1u << (addr % 8))) != 0;
+}
+
 int cc2k5_init(void)
 {
 	int ret;
@@ -84,6 +141,8 @@ int cc2k5_init(void)
 		spi_transfer(tx, rx, 1);
 	} while((rx[0] & CHIP_RDYn) != 0);
 
+	cc2k5_shadow_reset();
+
 	tx[0] = BURST | READ | PARTNUM;
 	tx[1] = 0x00;
 	do {
@@ -91,7 +150,7 @@ int cc2k5_init(void)
 	} while ((rx[0] & CHIP_RDYn) != 0);
 
 	if (rx[1] != CC2K5_PARTNUM) {
-		errno = ENODEV;
+		CC2K5_ERRNO(ENODEV);
 		return -1;
 	}
 
@@ -102,10 +161,53 @@ void cc2k5_set_register(uint8_t addr, uint8_t val)
 {
 	uint8_t tx[2];
 
+	if (addr < CC2K5_N_CONFIG && shadow[addr] == val
+			&& shadow_valid(addr))
+		return;
+
 	tx[0] = SINGLE | WRITE | addr;
 	tx[1] = val;
 
 	spi_transfer(tx, NULL, 2);
+
+	shadow_update(addr, &val, 1);
+}
+
+void cc2k5_write_burst(uint8_t addr, const void *buf, uint8_t n_bytes)
+{
+	if (n_bytes > CC2K5_FIFO_SIZE)
+		n_bytes = CC2K5_FIFO_SIZE;
+
+	xfer[0] = BURST | WRITE | addr;
+	memcpy(xfer + 1, buf, n_bytes);
+
+	spi_transfer(xfer, NULL, n_bytes + 1);
+
+	shadow_update(addr, buf, n_bytes);
+}
+
+void cc2k5_shadow_reset(void)
+{
+	memset(shadow_known, 0, sizeof(shadow_known));
+	pa_known = 0;
+}
+
+void cc2k5_shadow_write(uint8_t addr, const void *buf, uint8_t n_bytes)
+{
+	shadow_update(addr, buf, n_bytes);
+}
+
+void cc2k5_read_burst(uint8_t addr, void *buf, uint8_t n_bytes)
+{
+	if (n_bytes > CC2K5_FIFO_SIZE)
+		n_bytes = CC2K5_FIFO_SIZE;
+
+	memset(xfer, 0, n_bytes + 1);
+	xfer[0] = BURST | READ | addr;
+
+	spi_transfer(xfer, xfer, n_bytes + 1);
+
+	memcpy(buf, xfer + 1, n_bytes);
 }
 
 uint8_t cc2k5_get_register(uint8_t addr)
@@ -121,6 +223,19 @@ uint8_t cc2k5_get_register(uint8_t addr)
 	return rx[1];
 }
 
+uint8_t cc2k5_get_status(uint8_t addr)
+{
+	uint8_t tx[2];
+	uint8_t rx[2];
+
+	tx[0] = BURST | READ | addr;
+	tx[1] = 0x00;
+
+	spi_transfer(tx, rx, 2);
+
+	return rx[1];
+}
+
 void cc2k5_send_cmnd(uint8_t command)
 {
 	spi_transfer(&command, NULL, 1);
@@ -128,48 +243,150 @@ void cc2k5_send_cmnd(uint8_t command)
 
 void cc2k5_send(void *buf, uint8_t n_bytes)
 {
-	uint8_t *tx;
+	if (n_bytes > CC2K5_FIFO_SIZE)
+		n_bytes = CC2K5_FIFO_SIZE;
 
-	tx = malloc(n_bytes + 1);
-	if (tx == NULL)
-		return;
+	xfer[0] = BURST | WRITE | FIFO;
+	memcpy(xfer + 1, buf, n_bytes);
+
+	spi_transfer(xfer, NULL, n_bytes + 1);
 
+	cc2k5_send_cmnd(SINGLE | WRITE | STX);
+}
+
+void cc2k5_send_frame(void *frame, uint8_t n_bytes)
+{
+	uint8_t *tx, strobe;
+
+	tx = frame;
 	tx[0] = BURST | WRITE | FIFO;
-	memcpy(tx + 1, buf, n_bytes);
 
 	spi_transfer(tx, NULL, n_bytes + 1);
 
-	tx[0] = SINGLE | WRITE | STX;
-	spi_transfer(tx, NULL, 1);
+	strobe = SINGLE | WRITE | STX;
+	spi_transfer(&strobe, NULL, 1);
+}
 
-	free(tx);
+void cc2k5_read_fifo(void *buf, uint8_t n_bytes)
+{
+	cc2k5_read_burst(FIFO, buf, n_bytes);
 }
 
 void cc2k5_recv(void *buf, uint8_t *n_bytes)
 {
-	uint8_t status, *tx, *rx;
+	uint8_t status;
 
 	spi_transfer(NULL, &status, 1);
-	*n_bytes = status & 0x0F;
+	*n_bytes = status & FIFO_BYTES_AVAILABLE;
 
-	tx = malloc(*n_bytes + 1);
-	if (tx == NULL)
-		return;
+	if (*n_bytes > 0)
+		cc2k5_read_fifo(buf, *n_bytes);
+}
+
+/*
+ * Whether the CC2500 changes the register on its own, so that it cannot be
+ * verified: FSCAL3 to FSCAL1 hold the results of the last calibration.
+ */
+static int volatile_register(uint8_t addr)
+{
+	return addr >= FSCAL3 && addr <= FSCAL1;
+}
+
+/*
+ * Puts the CC2500 into IDLE, so that its configuration may be written.
+ *
+ * \return	The state it was in before, one of `CC2K5_STATES`.
+ */
+static uint8_t enter_idle(void)
+{
+	uint8_t strobe, status;
 
-	rx = malloc(*n_bytes + 1);
-	if (rx == NULL) {
-		free(tx);
+	strobe = SINGLE | WRITE | SIDLE;
+	spi_transfer(&strobe, &status, 1);
+
+	return (status & STATE) >> 4;
+}
+
+/*
+ * Stores a mismatch in `m` if there is room for it.
+ */
+static void report(struct lc_mismatch *m, unsigned int max, unsigned int n,
+		uint8_t addr, uint8_t index, uint8_t expected, uint8_t actual)
+{
+	if (n >= max)
 		return;
+
+	m[n].addr = addr;
+	m[n].index = index;
+	m[n].expected = expected;
+	m[n].actual = actual;
+}
+
+unsigned int cc2k5_verify(struct lc_mismatch *m, unsigned int max,
+		int repair)
+{
+	uint8_t actual[CC2K5_N_CONFIG], pa[CC2K5_PATABLE_SIZE];
+	uint8_t addr, start, last, state;
+	unsigned int n;
+	int bad, idle;
+
+	cc2k5_read_burst(0x00, actual, sizeof(actual));
+	cc2k5_read_burst(PATABLE, pa, sizeof(pa));
+
+	/*
+	 * Runs of mismatching registers are rewritten in one burst each, as
+	 * soon as the run ends. The CC2500 is only taken out of its current
+	 * state before the first one.
+	 */
+	idle = 0;
+	state = CC2K5_IDLE;
+	n = 0;
+	start = CC2K5_N_CONFIG;
+	for (addr = 0; addr <= CC2K5_N_CONFIG; addr++) {
+		bad = addr < CC2K5_N_CONFIG && shadow_valid(addr)
+				&& !volatile_register(addr)
+				&& shadow[addr] != actual[addr];
+
+		if (bad) {
+			report(m, max, n++, addr, 0, shadow[addr],
+					actual[addr]);
+			if (start == CC2K5_N_CONFIG)
+				start = addr;
+		}
+		else if (start != CC2K5_N_CONFIG) {
+			if (repair) {
+				if (!idle)
+					state = enter_idle();
+				idle = 1;
+				cc2k5_write_burst(start, shadow + start,
+						addr - start);
+			}
+			start = CC2K5_N_CONFIG;
+		}
 	}
 
-	tx[0] = BURST | READ | FIFO;
+	/* A burst write to the PA table always starts with the first entry. */
+	last = 0;
+	for (addr = 0; addr < CC2K5_PATABLE_SIZE; addr++) {
+		if ((pa_known & (1u << addr)) == 0 || pa_shadow[addr] == pa[addr])
+			continue;
 
-	spi_transfer(tx, rx, *n_bytes  + 1);
+		report(m, max, n++, PATABLE, addr, pa_shadow[addr], pa[addr]);
+		pa[addr] = pa_shadow[addr];
+		last = addr + 1;
+	}
+	if (repair && last > 0) {
+		if (!idle)
+			state = enter_idle();
+		idle = 1;
+		cc2k5_write_burst(PATABLE, pa, last);
+	}
 
-	memcpy(buf, rx + 1, *n_bytes);
+	/* back to receiving, if the CC2500 was interrupted doing so */
+	if (idle && state == CC2K5_RX)
+		cc2k5_send_cmnd(SINGLE | WRITE | SRX);
 
-	free(rx);
-	free(tx);
+	return n;
 }
 
 #ifdef __cplusplus
@@ -28,6 +28,17 @@ extern "C" {
 
 #include <stdint.h>
 
+/*
+ * In the freestanding profile there might be no errno, errors are reported by
+ * the return values only then.
+ */
+#ifdef LC_FREESTANDING
+#define CC2K5_ERRNO(e)	((void)0)
+#else
+#include <errno.h>
+#define CC2K5_ERRNO(e)	(errno = (e))
+#endif	/* LC_FREESTANDING */
+
 /**
  * \brief	Initializes the CC2500 driver.
  *
@@ -44,6 +55,9 @@ int cc2k5_init(void);
 /**
  * \brief	Sets one of the CC2500's configuration registers.
  *
+ * The driver keeps a shadow copy of the configuration registers, a write that
+ * would not change the value of the register is skipped.
+ *
  * \param[in]	reg	The address of the register. You should use the
  * 			constants in \f cc2500_regmap.h.
  *
@@ -51,6 +65,41 @@ int cc2k5_init(void);
  */
 void cc2k5_set_register(uint8_t reg, uint8_t val);
 
+/**
+ * \brief	Writes `n_bytes` consecutive registers in a single burst.
+ *
+ * \param[in]	addr	The address of the first register.
+ * \param[in]	buf	The values for the registers.
+ * \param[in]	n_bytes	The number of registers to write, at most 64.
+ */
+void cc2k5_write_burst(uint8_t addr, const void *buf, uint8_t n_bytes);
+
+/**
+ * \brief	Forgets the values of all registers, as after a reset of the
+ *		CC2500 by other means than cc2k5_init().
+ */
+void cc2k5_shadow_reset(void);
+
+/**
+ * \brief	Records that `n_bytes` consecutive registers have been written by
+ *		other means than this driver, so that cc2k5_set_register() and
+ *		cc2k5_verify() know their values.
+ *
+ * \param[in]	addr	The address of the first register, or PATABLE.
+ * \param[in]	buf	The values written to the registers.
+ * \param[in]	n_bytes	The number of registers written.
+ */
+void cc2k5_shadow_write(uint8_t addr, const void *buf, uint8_t n_bytes);
+
+/**
+ * \brief	Reads `n_bytes` consecutive registers in a single burst.
+ *
+ * \param[in]	addr	The address of the first register.
+ * \param[out]	buf	Will be filled with the values of the registers.
+ * \param[in]	n_bytes	The number of registers to read, at most 64.
+ */
+void cc2k5_read_burst(uint8_t addr, void *buf, uint8_t n_bytes);
+
 /**
  * \brief	Reads a value from one of the CC2500's configuration or status
  *              registers.
@@ -62,6 +111,18 @@ void cc2k5_set_register(uint8_t reg, uint8_t val);
  */
 uint8_t cc2k5_get_register(uint8_t addr);
 
+/**
+ * \brief	Reads one of the CC2500's status registers.
+ *
+ * The status registers share their addresses with the command strobes and thus
+ * cannot be read by cc2k5_get_register().
+ *
+ * \param[in]	addr	One of `CC2K5_REGISTERS_STATUS`.
+ *
+ * \return	The current value of the register.
+ */
+uint8_t cc2k5_get_status(uint8_t addr);
+
 /**
  * \brief	Sends a command with the command code in `command` to the CC2500.
  *
@@ -73,10 +134,51 @@ void cc2k5_send_cmnd(uint8_t command);
  * \brief	Sends out data via the CC2500 RF link.
  *
  * \param[in]	buf	The data that should be sent.
- * \param[in]	n_bytes	The number of bytes in `buf`.
+ * \param[in]	n_bytes	The number of bytes in `buf`, at most 64.
  */
 void cc2k5_send(void *buf, uint8_t n_bytes);
 
+/**
+ * \brief	Sends out a pre-encoded frame via the CC2500 RF link.
+ *
+ * In contrast to cc2k5_send(), the data is not copied. Instead, the first byte
+ * of `frame` is reserved for the SPI header, which is filled in by the driver,
+ * and is immediately followed by the `n_bytes` bytes to send.
+ *
+ * \param[in]	frame	The header byte followed by the data to send.
+ * \param[in]	n_bytes	The number of bytes to send, excluding the header.
+ */
+void cc2k5_send_frame(void *frame, uint8_t n_bytes);
+
+/**
+ * \brief	Reads `n_bytes` bytes from the RX FIFO in a single burst.
+ *
+ * \param[out]	buf	Will be filled with the data read.
+ * \param[in]	n_bytes	The number of bytes to read, at most 64.
+ */
+void cc2k5_read_fifo(void *buf, uint8_t n_bytes);
+
+struct lc_mismatch;
+
+/**
+ * \brief	Reads back the configuration registers and the PA table in two
+ *		bursts and compares them to the values last written.
+ *
+ * Only registers that have been written since the last reset are compared,
+ * apart from FSCAL3 to FSCAL1, which the CC2500 changes on calibration.
+ *
+ * \param[out]	m	The first `max` mismatches.
+ * \param[in]	max	The number of entries in `m`.
+ * \param[in]	repair	Whether to rewrite the mismatching registers, each run
+ *			of consecutive ones in a single burst. The CC2500 is put
+ *			into IDLE before the first one is written, and resumes
+ *			receiving afterwards if it did before.
+ *
+ * \return	The number of mismatches, which may exceed `max`.
+ */
+unsigned int cc2k5_verify(struct lc_mismatch *m, unsigned int max,
+		int repair);
+
 /**
  * \brief	Receives data via the CC2500 RF link.
  *
@@ -0,0 +1,356 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CC2500_HPP_
+#define CC2500_HPP_
+
+/*
+ * A header-only C++17 variant of the CC2500 driver.
+ *
+ * The driver is a template over the SPI backend, a class with the static
+ * members
+ *
+ *	static int init();
+ *	static int transfer(const std::uint8_t *tx, std::uint8_t *rx,
+ *			std::uint8_t n_bytes);
+ *
+ * with the semantics of spi_init() and spi_transfer(), so that a backend which
+ * is visible to the compiler is inlined into every access. c_spi forwards to
+ * the functions that the application provides for the C driver.
+ *
+ * On c_spi, the driver shares the CC2500 with the C driver and keeps the shadow
+ * of its registers up to date, so that both may be used side by side and
+ * cc2k5_verify() checks what has been written here. Other backends drive a
+ * CC2500 that the C driver does not know about.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "../liblicor.h"
+#include "cc2500.h"
+#include "cc2500_regmap.h"
+
+namespace cc2k5 {
+
+/**
+ * The configuration registers, see `CC2K_REGISTERS_CONFIGURATION`.
+ */
+enum class reg : std::uint8_t {
+	IOCFG2 = ::IOCFG2, IOCFG1 = ::IOCFG1, IOCFG0 = ::IOCFG0,
+	FIFOTHR = ::FIFOTHR, SYNC1 = ::SYNC1, SYNC0 = ::SYNC0,
+	PKTLEN = ::PKTLEN, PKTCTRL1 = ::PKTCTRL1, PKTCTRL0 = ::PKTCTRL0,
+	ADDR = ::ADDR, CHANNR = ::CHANNR, FSCTRL1 = ::FSCTRL1,
+	FSCTRL0 = ::FSCTRL0, FREQ2 = ::FREQ2, FREQ1 = ::FREQ1,
+	FREQ0 = ::FREQ0, MDMCFG4 = ::MDMCFG4, MDMCFG3 = ::MDMCFG3,
+	MDMCFG2 = ::MDMCFG2, MDMCFG1 = ::MDMCFG1, MDMCFG0 = ::MDMCFG0,
+	DEVIATN = ::DEVIATN, MCSM2 = ::MCSM2, MCSM1 = ::MCSM1,
+	MCSM0 = ::MCSM0, FOCCFG = ::FOCCFG, BSCFG = ::BSCFG,
+	AGCTRL2 = ::AGCTRL2, AGCTRL1 = ::AGCTRL1, AGCTRL0 = ::AGCTRL0,
+	WOREVT1 = ::WOREVT1, WOREVT0 = ::WOREVT0, WORCTRL = ::WORCTRL,
+	FREND1 = ::FREND1, FREND0 = ::FREND0, FSCAL3 = ::FSCAL3,
+	FSCAL2 = ::FSCAL2, FSCAL1 = ::FSCAL1, FSCAL0 = ::FSCAL0,
+	RCCTRL1 = ::RCCTRL1, RCCTRL0 = ::RCCTRL0, FSTEST = ::FSTEST,
+	PTEST = ::PTEST, AGCTEST = ::AGCTEST, TEST2 = ::TEST2,
+	TEST1 = ::TEST1, TEST0 = ::TEST0
+};
+
+/**
+ * The status registers, see `CC2K5_REGISTERS_STATUS`.
+ */
+enum class status : std::uint8_t {
+	PARTNUM = ::PARTNUM, VERSION = ::VERSION, FREQEST = ::FREQEST,
+	LQI = ::LQI, RSSI = ::RSSI, MARCSTATE = ::MARCSTATE,
+	WORTIME1 = ::WORTIME1, WORTIME0 = ::WORTIME0,
+	PKTSTATUS = ::PKTSTATUS, VCO_VC_DAC = ::VCO_VC_DAC,
+	TXBYTES = ::TXBYTES, RXBYTES = ::RXBYTES,
+	RCCTRL1_STATUS = ::RCCTRL1_STATUS, RCCTRL0_STATUS = ::RCCTRL0_STATUS
+};
+
+/**
+ * The command strobes, see `CC2K5_COMMAND_STROBES`.
+ */
+enum class strobe : std::uint8_t {
+	SRES = ::SRES, SFSTXON = ::SFSTXON, SXOFF = ::SXOFF, SCAL = ::SCAL,
+	SRX = ::SRX, STX = ::STX, SIDLE = ::SIDLE, SAFC = ::SAFC,
+	SWOR = ::SWOR, SPWD = ::SPWD, SFRX = ::SFRX, SFTX = ::SFTX,
+	SWORRST = ::SWORRST, SNOP = ::SNOP
+};
+
+/**
+ * Bits of the SPI header byte.
+ */
+namespace header {
+constexpr std::uint8_t read = 0x80;	/**< Read access. */
+constexpr std::uint8_t burst = 0x40;	/**< Burst access. */
+}
+
+/**
+ * The CHIP_RDYn bit of the status byte, high until the crystal is stable.
+ */
+constexpr std::uint8_t chip_rdyn = 0x80;
+
+/**
+ * The number of configuration registers, which start at address 0.
+ */
+constexpr std::size_t n_config = static_cast<std::size_t>(reg::TEST0) + 1;
+
+/**
+ * The size of the RX and TX FIFOs.
+ */
+constexpr std::size_t fifo_size = 64;
+
+/**
+ * The contents of the PARTNUM register.
+ */
+constexpr std::uint8_t partnum = 0x80;
+
+/**
+ * A value for a configuration register.
+ */
+struct setting {
+	reg addr;		/**< The register. */
+	std::uint8_t val;	/**< The value to write. */
+};
+
+/**
+ * Whether `s` can be packed by pack(): the registers must be given in
+ * ascending order, each at most once.
+ */
+template <std::size_t N>
+constexpr bool valid(const std::array<setting, N> &s)
+{
+	for (std::size_t i = 1; i < N; i++) {
+		if (s[i].addr <= s[i - 1].addr)
+			return false;
+	}
+
+	return N > 0;
+}
+
+/**
+ * The number of runs of consecutive registers in `s`, each of which is written
+ * as one burst.
+ */
+template <std::size_t N>
+constexpr std::size_t segments(const std::array<setting, N> &s)
+{
+	std::size_t n = N > 0;
+
+	for (std::size_t i = 1; i < N; i++) {
+		if (static_cast<std::size_t>(s[i].addr)
+				!= static_cast<std::size_t>(s[i - 1].addr) + 1)
+			n++;
+	}
+
+	return n;
+}
+
+/**
+ * A configuration packed into bursts, as produced by pack().
+ *
+ * `bytes` holds the segments back to back, each being the SPI header for a
+ * burst write to its first register followed by the values, so that every
+ * segment goes to the bus as is.
+ */
+template <std::size_t B, std::size_t S>
+struct burst_config {
+	std::array<std::uint8_t, B> bytes;	/**< The segments. */
+	std::array<std::uint8_t, S> length;	/**< Bytes per segment. */
+};
+
+/**
+ * Packs the settings `s` into `S` burst segments at compile time, where `S`
+ * must be segments(s).
+ */
+template <std::size_t S, std::size_t N>
+constexpr burst_config<N + S, S> pack(const std::array<setting, N> &s)
+{
+	burst_config<N + S, S> c{};
+	std::size_t i = 0, k = 0, out = 0;
+
+	for (; i < N; k++) {
+		c.bytes[out++] = header::burst
+				| static_cast<std::uint8_t>(s[i].addr);
+		c.length[k] = 1;
+		do {
+			c.bytes[out++] = s[i].val;
+			c.length[k]++;
+			i++;
+		} while (i < N && static_cast<std::size_t>(s[i].addr)
+				== static_cast<std::size_t>(s[i - 1].addr) + 1);
+	}
+
+	return c;
+}
+
+/**
+ * The SPI backend of the C driver, i.e. spi_init() and spi_transfer() as
+ * provided by the application.
+ */
+struct c_spi {
+	static int init()
+	{
+		return ::spi_init();
+	}
+
+	static int transfer(const std::uint8_t *tx, std::uint8_t *rx,
+			std::uint8_t n_bytes)
+	{
+		return ::spi_transfer(const_cast<std::uint8_t *>(tx), rx,
+				n_bytes);
+	}
+};
+
+/**
+ * The CC2500 driver on top of the SPI backend `Spi`.
+ *
+ * The driver has no state of its own, every member is static.
+ */
+template <class Spi>
+struct driver {
+	/**
+	 * Whether the CC2500 is the one of the C driver.
+	 */
+	static constexpr bool shared = std::is_same_v<Spi, c_spi>;
+
+	/**
+	 * Same as cc2k5_init().
+	 */
+	static int init()
+	{
+		std::uint8_t tx[2], rx[2];
+
+		if (Spi::init() != 0)
+			return -1;
+
+		tx[0] = static_cast<std::uint8_t>(strobe::SRES);
+		do {
+			Spi::transfer(tx, rx, 1);
+		} while ((rx[0] & chip_rdyn) != 0);
+
+		if constexpr (shared)
+			::cc2k5_shadow_reset();
+
+		tx[0] = header::burst | header::read
+				| static_cast<std::uint8_t>(status::PARTNUM);
+		tx[1] = 0;
+		do {
+			Spi::transfer(tx, rx, 2);
+		} while ((rx[0] & chip_rdyn) != 0);
+
+		if (rx[1] != partnum) {
+			CC2K5_ERRNO(ENODEV);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Writes a configuration that has been packed by pack().
+	 */
+	template <std::size_t B, std::size_t S>
+	static void configure(const burst_config<B, S> &c)
+	{
+		std::size_t i, offset;
+
+		for (i = 0, offset = 0; i < S; offset += c.length[i++]) {
+			Spi::transfer(&c.bytes[offset], nullptr, c.length[i]);
+			if constexpr (shared)
+				::cc2k5_shadow_write(c.bytes[offset]
+						& ~header::burst,
+						&c.bytes[offset + 1],
+						c.length[i] - 1);
+		}
+	}
+
+	static void write(reg addr, std::uint8_t val)
+	{
+		const std::uint8_t tx[2] = {static_cast<std::uint8_t>(addr),
+				val};
+
+		Spi::transfer(tx, nullptr, 2);
+		if constexpr (shared)
+			::cc2k5_shadow_write(tx[0], &tx[1], 1);
+	}
+
+	/**
+	 * Writes the first entry of the PA table.
+	 */
+	static void write_patable(std::uint8_t val)
+	{
+		const std::uint8_t tx[2] = {PATABLE, val};
+
+		Spi::transfer(tx, nullptr, 2);
+		if constexpr (shared)
+			::cc2k5_shadow_write(PATABLE, &val, 1);
+	}
+
+	static std::uint8_t read(reg addr)
+	{
+		const std::uint8_t tx[2] = {static_cast<std::uint8_t>(
+				header::read | static_cast<std::uint8_t>(addr)),
+				0};
+		std::uint8_t rx[2];
+
+		Spi::transfer(tx, rx, 2);
+
+		return rx[1];
+	}
+
+	static std::uint8_t read(status addr)
+	{
+		const std::uint8_t tx[2] = {static_cast<std::uint8_t>(
+				header::read | header::burst
+				| static_cast<std::uint8_t>(addr)), 0};
+		std::uint8_t rx[2];
+
+		Spi::transfer(tx, rx, 2);
+
+		return rx[1];
+	}
+
+	static void command(strobe s)
+	{
+		const std::uint8_t tx = static_cast<std::uint8_t>(s);
+
+		Spi::transfer(&tx, nullptr, 1);
+	}
+
+	/**
+	 * Same as cc2k5_send_frame().
+	 */
+	static void send_frame(void *frame, std::uint8_t n_bytes)
+	{
+		std::uint8_t *tx = static_cast<std::uint8_t *>(frame);
+
+		tx[0] = header::burst | FIFO;
+		Spi::transfer(tx, nullptr, n_bytes + 1);
+		command(strobe::STX);
+	}
+};
+
+}	/* namespace cc2k5 */
+
+#endif	/* CC2500_HPP_ */
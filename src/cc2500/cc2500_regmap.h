@@ -106,6 +106,52 @@ enum CC2K5_REGISTER_CONFIGURATION_IOCFG2 {
 	GDO2_INV	= BIT(6)
 };
 
+enum CC2K5_REGISTER_CONFIGURATION_MCSM2 {
+	/** Stay in RX past the timeout if a sync word has been found. */
+	RX_TIME_QUAL	= BIT(3),
+	/** The RX timeout in WOR mode, as a fraction of the EVENT0 period. */
+	RX_TIME		= BIT(2) | BIT(1) | BIT(0)
+};
+
+enum CC2K5_REGISTER_CONFIGURATION_MCSM0 {
+	/** When to calibrate the frequency synthesizer automatically. */
+	FS_AUTOCAL	= BIT(5) | BIT(4)
+};
+
+enum CC2K5_REGISTER_CONFIGURATION_MCSM1 {
+	/** The state to enter when a packet has been received. */
+	RXOFF_MODE	= BIT(3) | BIT(2),
+	/** The state to enter when a packet has been sent. */
+	TXOFF_MODE	= BIT(1) | BIT(0),
+	/** TXOFF_MODE: Go to RX. */
+	TXOFF_RX	= BIT(1) | BIT(0)
+};
+
+enum CC2K5_REGISTER_CONFIGURATION_WORCTRL {
+	/** Power down the RC oscillator, which WOR needs running. */
+	RC_PD		= BIT(7),
+	/** The timeout of EVENT1, i.e. the wake up time of the crystal. */
+	EVENT1		= BIT(6) | BIT(5) | BIT(4),
+	/** Calibrate the RC oscillator automatically. */
+	RC_CAL		= BIT(3),
+	/** The resolution of EVENT0, 2^(5 * WOR_RES) periods. */
+	WOR_RES		= BIT(1) | BIT(0)
+};
+
+enum CC2K5_REGISTER_STATUS_RXBYTES {
+	/** The RX FIFO has overflowed and needs to be flushed with SFRX. */
+	RXFIFO_OVERFLOW	= BIT(7),
+	/** The number of bytes in the RX FIFO. */
+	NUM_RXBYTES	= 0x7F
+};
+
+enum CC2K5_REGISTER_STATUS_TXBYTES {
+	/** The TX FIFO has underflowed and needs to be flushed with SFTX. */
+	TXFIFO_UNDERFLOW = BIT(7),
+	/** The number of bytes in the TX FIFO. */
+	NUM_TXBYTES	= 0x7F
+};
+
 enum CC2K5_REGISTERS_STATUS {
 	PARTNUM		= 0x30,	/**< CC2500 part number (0x81) */
 	VERSION		= 0x31,	/**< Current version number */
@@ -146,7 +192,13 @@ enum CC2K5_COMMAND_STROBES {
 	 * mode if applicable.
 	 */
 	SIDLE	= 0x36,	/**< */
-	SPWD	= 0x39	/**< Enter power down mode when CSn goes high. */
+	SAFC	= 0x37,	/**< Perform AFC adjustment of the freq. synthesizer. */
+	SWOR	= 0x38,	/**< Start automatic RX polling (Wake-on-Radio). */
+	SPWD	= 0x39,	/**< Enter power down mode when CSn goes high. */
+	SFRX	= 0x3A,	/**< Flush the RX FIFO buffer. */
+	SFTX	= 0x3B,	/**< Flush the TX FIFO buffer. */
+	SWORRST	= 0x3C,	/**< Reset real time clock. */
+	SNOP	= 0x3D	/**< No operation. */
 };
 
 #ifdef __cplusplus
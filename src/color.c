@@ -0,0 +1,244 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif	/* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "liblicor.h"
+
+/*
+ * The Philips hues of the primary and secondary colors. The hue look-up table
+ * interpolates linearly between these anchors, so the non-linear scale of the
+ * lamp can be adjusted by changing them.
+ */
+#define LC_HUE_RED	0
+#define LC_HUE_YELLOW	36
+#define LC_HUE_GREEN	80
+#define LC_HUE_CYAN	128
+#define LC_HUE_BLUE	172
+#define LC_HUE_MAGENTA	214
+
+/*
+ * Maps the hue `h` in [0, 255], which is linear to the hue angle, to the hue
+ * of the Philips scale by interpolating between the anchors of its sextant.
+ */
+#define SEGMENT(h, h0, h1, p0, p1) \
+	((p0) + ((h) - (h0)) * ((p1) - (p0)) / ((h1) - (h0)))
+#define HUE(h) (uint8_t)( \
+	(h) <  43 ? SEGMENT(h,   0,  43, LC_HUE_RED, LC_HUE_YELLOW) : \
+	(h) <  85 ? SEGMENT(h,  43,  85, LC_HUE_YELLOW, LC_HUE_GREEN) : \
+	(h) < 128 ? SEGMENT(h,  85, 128, LC_HUE_GREEN, LC_HUE_CYAN) : \
+	(h) < 171 ? SEGMENT(h, 128, 171, LC_HUE_CYAN, LC_HUE_BLUE) : \
+	(h) < 213 ? SEGMENT(h, 171, 213, LC_HUE_BLUE, LC_HUE_MAGENTA) : \
+		    SEGMENT(h, 213, 256, LC_HUE_MAGENTA, 256))
+
+/*
+ * 2^16 / d, rounded to the nearest integer and clipped to 16 bits, which
+ * replaces the divisions of the conversion by a multiplication.
+ */
+#define RECIP(d) (uint16_t)((d) < 2 ? 0xFFFF : (0x10000 + (d) / 2) / (d))
+
+#define REP4(f, n)	f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define REP16(f, n)	REP4(f, n), REP4(f, (n) + 4), REP4(f, (n) + 8), \
+			REP4(f, (n) + 12)
+#define REP64(f, n)	REP16(f, n), REP16(f, (n) + 16), REP16(f, (n) + 32), \
+			REP16(f, (n) + 48)
+#define REP256(f)	REP64(f, 0), REP64(f, 64), REP64(f, 128), REP64(f, 192)
+
+static const uint8_t hue_lut[256] = { REP256(HUE) };
+
+static const uint16_t recip_lut[256] = { REP256(RECIP) };
+
+#define KELVIN_MIN	1000
+#define KELVIN_MAX	10000
+#define KELVIN_STEP	100
+
+/*
+ * The conversion of rgb_to_color() as a constant expression, for tables of
+ * colors that are given as RGB.
+ */
+#define MAX3(r, g, b)	((r) > (g) ? ((r) > (b) ? (r) : (b)) \
+			: ((g) > (b) ? (g) : (b)))
+#define MIN3(r, g, b)	((r) < (g) ? ((r) < (b) ? (r) : (b)) \
+			: ((g) < (b) ? (g) : (b)))
+#define DELTA(r, g, b)	(MAX3(r, g, b) - MIN3(r, g, b))
+#define SCALE(x, d)	(uint8_t)(((uint32_t)(x) * RECIP(d) + 0x8000) >> 16)
+#define BASE(r, g, b)	(MAX3(r, g, b) == (r) ? 0 \
+			: MAX3(r, g, b) == (g) ? 85 : 171)
+#define DIFF(r, g, b)	(MAX3(r, g, b) == (r) ? (g) - (b) \
+			: MAX3(r, g, b) == (g) ? (b) - (r) : (r) - (g))
+#define ABSDIFF(r, g, b) \
+	(DIFF(r, g, b) < 0 ? -DIFF(r, g, b) : DIFF(r, g, b))
+#define Q(r, g, b)	SCALE(43 * ABSDIFF(r, g, b), DELTA(r, g, b))
+#define COLOR(r, g, b) { \
+	DELTA(r, g, b) == 0 ? 0 : HUE((uint8_t)(DIFF(r, g, b) < 0 \
+			? BASE(r, g, b) - Q(r, g, b) \
+			: BASE(r, g, b) + Q(r, g, b))), \
+	DELTA(r, g, b) == 0 ? 0 : SCALE(255 * DELTA(r, g, b), MAX3(r, g, b)), \
+	MAX3(r, g, b) }
+
+/*
+ * The colors of a black body from 1000 K to 10000 K in steps of 100 K, whose
+ * RGB values are approximated by Tanner Helland's algorithm and converted at
+ * compile time.
+ */
+static const struct color kelvin_lut[] = {
+	COLOR(255,  68,   0), COLOR(255,  77,   0), COLOR(255,  86,   0),
+	COLOR(255,  94,   0), COLOR(255, 101,   0), COLOR(255, 108,   0),
+	COLOR(255, 115,   0), COLOR(255, 121,   0), COLOR(255, 126,   0),
+	COLOR(255, 132,   0), COLOR(255, 137,  14), COLOR(255, 142,  27),
+	COLOR(255, 146,  39), COLOR(255, 151,  50), COLOR(255, 155,  61),
+	COLOR(255, 159,  70), COLOR(255, 163,  79), COLOR(255, 167,  87),
+	COLOR(255, 170,  95), COLOR(255, 174, 103), COLOR(255, 177, 110),
+	COLOR(255, 180, 117), COLOR(255, 184, 123), COLOR(255, 187, 129),
+	COLOR(255, 190, 135), COLOR(255, 193, 141), COLOR(255, 195, 146),
+	COLOR(255, 198, 151), COLOR(255, 201, 157), COLOR(255, 203, 161),
+	COLOR(255, 206, 166), COLOR(255, 208, 171), COLOR(255, 211, 175),
+	COLOR(255, 213, 179), COLOR(255, 215, 183), COLOR(255, 218, 187),
+	COLOR(255, 220, 191), COLOR(255, 222, 195), COLOR(255, 224, 199),
+	COLOR(255, 226, 202), COLOR(255, 228, 206), COLOR(255, 230, 209),
+	COLOR(255, 232, 213), COLOR(255, 234, 216), COLOR(255, 236, 219),
+	COLOR(255, 237, 222), COLOR(255, 239, 225), COLOR(255, 241, 228),
+	COLOR(255, 243, 231), COLOR(255, 244, 234), COLOR(255, 246, 237),
+	COLOR(255, 248, 240), COLOR(255, 249, 242), COLOR(255, 251, 245),
+	COLOR(255, 253, 248), COLOR(255, 254, 250), COLOR(255, 255, 255),
+	COLOR(254, 249, 255), COLOR(250, 246, 255), COLOR(246, 244, 255),
+	COLOR(243, 242, 255), COLOR(240, 240, 255), COLOR(237, 239, 255),
+	COLOR(234, 237, 255), COLOR(232, 236, 255), COLOR(230, 235, 255),
+	COLOR(228, 234, 255), COLOR(226, 233, 255), COLOR(224, 232, 255),
+	COLOR(223, 231, 255), COLOR(221, 230, 255), COLOR(220, 229, 255),
+	COLOR(218, 228, 255), COLOR(217, 227, 255), COLOR(216, 227, 255),
+	COLOR(215, 226, 255), COLOR(214, 225, 255), COLOR(213, 225, 255),
+	COLOR(212, 224, 255), COLOR(211, 223, 255), COLOR(210, 223, 255),
+	COLOR(209, 222, 255), COLOR(208, 222, 255), COLOR(207, 221, 255),
+	COLOR(206, 221, 255), COLOR(205, 220, 255), COLOR(205, 220, 255),
+	COLOR(204, 219, 255), COLOR(203, 219, 255), COLOR(202, 218, 255),
+	COLOR(202, 218, 255)
+};
+
+/*
+ * Returns x / d, rounded to the nearest integer.
+ */
+static inline uint8_t scale(uint16_t x, uint8_t d)
+{
+	return (uint8_t)(((uint32_t)x * recip_lut[d] + 0x8000) >> 16);
+}
+
+static inline void rgb_to_color(struct color *c, uint8_t r, uint8_t g,
+		uint8_t b)
+{
+	uint8_t max, min, delta, q;
+	int16_t base, diff;
+
+	max = r > g ? r : g;
+	max = max > b ? max : b;
+	min = r < g ? r : g;
+	min = min < b ? min : b;
+	delta = max - min;
+
+	c->value = max;
+
+	if (delta == 0) {
+		c->hue = 0;
+		c->saturation = 0;
+		return;
+	}
+
+	if (max == r) {
+		base = 0;
+		diff = g - b;
+	}
+	else if (max == g) {
+		base = 85;
+		diff = b - r;
+	}
+	else {
+		base = 171;
+		diff = r - g;
+	}
+
+	q = scale(43 * (diff < 0 ? -diff : diff), delta);
+
+	c->hue = hue_lut[(uint8_t)(diff < 0 ? base - q : base + q)];
+	c->saturation = scale(255 * delta, max);
+}
+
+void lc_color_from_rgb(struct color *c, uint8_t r, uint8_t g, uint8_t b)
+{
+	rgb_to_color(c, r, g, b);
+}
+
+void lc_color_from_kelvin(struct color *c, uint16_t kelvin)
+{
+	if (kelvin < KELVIN_MIN)
+		kelvin = KELVIN_MIN;
+	else if (kelvin > KELVIN_MAX)
+		kelvin = KELVIN_MAX;
+
+	*c = kelvin_lut[(kelvin - KELVIN_MIN + KELVIN_STEP / 2) / KELVIN_STEP];
+}
+
+uint8_t lc_color_delta(const struct color *a, const struct color *b)
+{
+	uint8_t dh, ds, dv, s, v, d;
+	uint32_t w;
+
+	dv = a->value > b->value ? a->value - b->value : b->value - a->value;
+	ds = a->saturation > b->saturation ? a->saturation - b->saturation
+			: b->saturation - a->saturation;
+	dh = a->hue > b->hue ? a->hue - b->hue : b->hue - a->hue;
+	if (dh > 128)
+		dh = 256 - dh;
+
+	s = a->saturation < b->saturation ? a->saturation : b->saturation;
+	v = a->value > b->value ? a->value : b->value;
+
+	ds = (uint8_t)(((uint16_t)ds * v) / 255);
+
+	/* A hue difference of 128 is the opposite side of the color wheel. */
+	w = (uint32_t)dh * 2 * s * v / (255u * 255u);
+	dh = w > 255 ? 255 : (uint8_t)w;
+
+	d = dv > ds ? dv : ds;
+
+	return d > dh ? d : dh;
+}
+
+uint8_t lc_hue_from_degrees(uint16_t degrees)
+{
+	return hue_lut[(uint8_t)(((uint32_t)(degrees % 360) * 256 + 180) / 360)];
+}
+
+void lc_colors_from_rgb(struct color *c, const uint8_t *rgb, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++, rgb += 3)
+		rgb_to_color(&c[i], rgb[0], rgb[1], rgb[2]);
+}
+
+#ifdef __cplusplus
+}
+#endif	/* __cplusplus */
@@ -28,7 +28,9 @@ extern "C" {
 
 #include "cc2500/cc2500.h"
 #include "cc2500/cc2500_regmap.h"
+#include "internal.h"
 #include "liblicor.h"
+#include "radio_config.h"
 
 enum LIVING_COLORS_COMMANDS {
 	LC_SET_COLOR = 3,
@@ -37,20 +39,218 @@ enum LIVING_COLORS_COMMANDS {
 };
 
 /**
- * This is the structure of the packets that are sent from the remote control to
- * the lamp.
- */
-#pragma pack(1)
-struct packet {
-	uint8_t preamble;		/**< This must always be 0x0E. */
-	uint8_t address[9];		/**< The address of the lamp. */
-	uint8_t command;		/**< The command to execute. */
-	uint8_t sequence_number;	/**< The packets sequence number. */
-	struct color color;		/**< The color of the lamp's light. */
+ * The offset of the RSSI as reported by the CC2500 at 250 kBaud.
+ */
+#define RSSI_OFFSET	72
+
+/**
+ * Set in the second status byte appended to a received packet if its CRC is
+ * correct. The remaining bits are the LQI.
+ */
+#define CRC_OK		0x80
+
+/**
+ * The values of the MARCSTATE register in the IDLE resp. RX state, and while a
+ * frame is on air.
+ */
+#define MARCSTATE_IDLE		0x01
+#define MARCSTATE_RX		0x0D
+#define MARCSTATE_TX		0x13
+#define MARCSTATE_TX_END	0x14
+
+/**
+ * How long to wait at most for the CC2500 to finish sending a frame, in us.
+ */
+#define TX_TIMEOUT_US	(2 * LC_FRAME_PERIOD_US)
+
+/**
+ * How often the CC2500 is polled at most for a state change if there is no
+ * `lc_clock` to time out with. This covers a few ms even at the fastest SPI
+ * clock the CC2500 supports.
+ */
+#define MAX_POLLS	4096
+
+/**
+ * The number of RSSI readings per channel during a sweep.
+ */
+#define SWEEP_SAMPLES	8
+
+/**
+ * How long a sweep waits at most for the CC2500 to calibrate or to enter RX, in
+ * us. Calibration takes about 0.8 ms.
+ */
+#define SWEEP_TIMEOUT_US	LC_FRAME_PERIOD_US
+
+/**
+ * The time the RSSI takes to settle after entering RX, in us, for the 541 kHz
+ * receive filter and the AGC settings of the configuration. It is a generous
+ * bound on the response time given in the CC2500 design note DN505.
+ */
+#define RSSI_SETTLE_US		100
+
+/**
+ * The RSSI above which a link is considered good resp. poor, in dBm. Each step
+ * below the good threshold adds a repetition.
+ */
+#define RSSI_GOOD	-60
+#define RSSI_POOR	-85
+#define RSSI_STEP	10
+
+/**
+ * The LQI above which a link is considered noisy, which adds a repetition.
+ */
+#define LQI_NOISY	40
+
+/**
+ * The frequency of the crystal in MHz, which clocks the WOR timer.
+ */
+#define WOR_CLOCK_MHZ	26
+
+/**
+ * The sniff period and RX timeout used by lc_learn(): 1.25 ms of every 10 ms.
+ */
+#define LEARN_PERIOD_US	10000
+#define LEARN_RX_TIME	0
+
+uint8_t lc_default_repetitions = 3;
+
+uint32_t (*lc_clock)(void);
+
+int (*lc_wait_gdo)(uint32_t timeout_us);
+
+/*
+ * The strobe that puts the CC2500 into receive mode: SRX to listen
+ * continuously, SWOR to sniff periodically.
+ */
+static uint8_t rx_strobe = SRX;
+
+uint32_t lc_confirm_window = 3 * LC_FRAME_PERIOD_US;
+
+static int8_t rssi_dbm(uint8_t raw)
+{
+	return (int8_t)((int8_t)raw / 2 - RSSI_OFFSET);
+}
+
+/*
+ * The configuration of the CC2500 for the Living Colors lamps as listed in
+ * radio_config.h, i.e. the values of all configuration registers from IOCFG2 to
+ * TEST0, which are written in a single burst.
+ */
+#define CONFIG_ENTRY(addr, val)	[addr] = val,
+static const uint8_t config[TEST0 + 1] = {
+	LC_CONFIG(CONFIG_ENTRY)
 };
-static struct packet p_buf = {0x0E, {0}, 0, 0, {0}};
+#undef CONFIG_ENTRY
+
+static struct lc_handle h_buf = {0, {0x0E, {0}, 0, 0, {0}}, 0, {0}, 0, 0, 0};
+
+struct color *lc_color = &(h_buf.packet.color);
+
+int lc_suppress_threshold = 0;
+
+struct lc_stats lc_stats;
+
+void (*lc_tap)(int direction, const struct lc_rx *rx);
+
+/*
+ * Hands a packet that is about to be sent to the tap.
+ */
+static void tap_tx(const struct lc_packet *p)
+{
+	struct lc_rx tx;
+
+	tx.packet = *p;
+	tx.rssi = 0;
+	tx.lqi = 0;
 
-struct color *lc_color = &(p_buf.color);
+	lc_tap(LC_TX, &tx);
+}
+
+/*
+ * Updates the mirrored state of `h` to reflect that `command` with `color` has
+ * been sent to the lamp.
+ */
+static void mirror(struct lc_handle *h, uint8_t command,
+		const struct color *color)
+{
+	switch (command) {
+	case LC_ON:
+	case LC_SET_COLOR:
+		h->state = LC_STATE_ON;
+		h->color = *color;
+		break;
+	case LC_OFF:
+		h->state = LC_STATE_OFF;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Whether a wait for the CC2500 that started at `start` and has polled it `i`
+ * times should give up after `timeout_us`.
+ */
+static int timed_out(uint32_t start, unsigned int i, uint32_t timeout_us)
+{
+	if (lc_clock != NULL)
+		return lc_clock() - start >= timeout_us;
+
+	return i >= MAX_POLLS;
+}
+
+/*
+ * Waits until the CC2500 is done with the previous frame. Writing the next one
+ * earlier would append it to the TX FIFO while the previous one is on air, and
+ * its STX strobe would be ignored.
+ */
+static void await_tx_end(void)
+{
+	uint32_t start;
+	unsigned int i;
+	uint8_t state;
+
+	start = lc_clock != NULL ? lc_clock() : 0;
+	for (i = 0; !timed_out(start, i, TX_TIMEOUT_US); i++) {
+		state = cc2k5_get_status(MARCSTATE);
+		if (state != MARCSTATE_TX && state != MARCSTATE_TX_END
+				&& (cc2k5_get_status(TXBYTES) & NUM_TXBYTES)
+				== 0)
+			return;
+	}
+}
+
+/*
+ * Patches the command into the frame of `h`, sends it once the previous frame
+ * is out and advances the sequence number.
+ */
+static void transmit(struct lc_handle *h, uint8_t command)
+{
+	h->packet.command = command;
+
+	await_tx_end();
+
+	if (lc_tap != NULL)
+		tap_tx(&(h->packet));
+
+	cc2k5_send_frame(h, sizeof(h->packet));
+
+	h->packet.sequence_number++;
+	lc_stats.sent++;
+
+	mirror(h, command, &(h->packet.color));
+}
+
+/*
+ * Whether the lamp of `h` is believed to be on and to show `color` already.
+ */
+static int shows(const struct lc_handle *h, const struct color *color)
+{
+	if (lc_suppress_threshold < 0 || h->state != LC_STATE_ON)
+		return 0;
+
+	return lc_color_delta(&(h->color), color) <= lc_suppress_threshold;
+}
 
 int lc_init(void)
 {
@@ -63,102 +263,589 @@ int lc_init(void)
 	/*
 	 * Configure the CC2500 for usage with the Living Colors lamps.
 	 */
-	cc2k5_set_register(IOCFG2,	0x06);
-	cc2k5_set_register(IOCFG0,	0x01);
-	cc2k5_set_register(FIFOTHR,	0x0D);
-	cc2k5_set_register(PKTLEN,	0xFF);
-	cc2k5_set_register(PKTCTRL1,	0x04);
-	cc2k5_set_register(PKTCTRL0,	0x45);
-	cc2k5_set_register(ADDR,	0x00);
-	cc2k5_set_register(CHANNR,	0x03);
-	cc2k5_set_register(FSCTRL1,	0x09);
-	cc2k5_set_register(FSCTRL0,	0x00);
-	cc2k5_set_register(FREQ2,	0x5D);
-	cc2k5_set_register(FREQ1,	0x93);
-	cc2k5_set_register(FREQ0,	0xB1);
-	cc2k5_set_register(MDMCFG4,	0x2D);
-	cc2k5_set_register(MDMCFG3,	0x3B);
-	cc2k5_set_register(MDMCFG2,	0x73);
-	cc2k5_set_register(MDMCFG1,	0x22);
-	cc2k5_set_register(MDMCFG0,	0xF8);
-	cc2k5_set_register(DEVIATN,	0x00);
-	cc2k5_set_register(MCSM0,	0x18);
-	cc2k5_set_register(FOCCFG,	0x1D);
-	cc2k5_set_register(BSCFG,	0x1C);
-	cc2k5_set_register(AGCTRL2,	0xC7);
-	cc2k5_set_register(AGCTRL1,	0x00);
-	cc2k5_set_register(AGCTRL0,	0xB2);
-	cc2k5_set_register(FREND1,	0xB6);
-	cc2k5_set_register(FREND0,	0x10);
-	cc2k5_set_register(FSCAL3,	0xEA);
-	cc2k5_set_register(FSCAL2,	0x0A);
-	cc2k5_set_register(FSCAL1,	0x00);
-	cc2k5_set_register(FSCAL0,	0x11);
-	cc2k5_set_register(FSTEST,	0x59);
-	cc2k5_set_register(TEST2,	0x88);
-	cc2k5_set_register(TEST1,	0x31);
-	cc2k5_set_register(TEST0,	0x0B);
-	cc2k5_set_register(PATABLE,	0xFF);
+	cc2k5_write_burst(IOCFG2, config, sizeof(config));
+	cc2k5_set_register(PATABLE,	LC_PA_POWER);
 
 	cc2k5_send_cmnd(SIDLE);
 	cc2k5_send_cmnd(SIDLE);
 	cc2k5_send_cmnd(SPWD);
 	cc2k5_send_cmnd(SIDLE);
 
+	rx_strobe = SRX;
+
 	return 0;
 }
 
+/*
+ * Restores the registers that lc_listen_wor() changes to the configuration, as
+ * the RX timeout in MCSM2 applies to continuous RX as well, and goes back to
+ * receiving with SRX. The CC2500 must be in IDLE.
+ */
+static void leave_wor(void)
+{
+	if (rx_strobe != SWOR)
+		return;
+
+	cc2k5_set_register(WOREVT1, config[WOREVT1]);
+	cc2k5_set_register(WOREVT0, config[WOREVT0]);
+	cc2k5_set_register(WORCTRL, config[WORCTRL]);
+	cc2k5_set_register(MCSM2, config[MCSM2]);
+
+	rx_strobe = SRX;
+}
+
 int lc_learn(struct lc_lamp *lamp, int max, uint8_t t)
 {
-	int n_lamps;
+	struct lc_rx rx;
+	uint32_t start, elapsed;
+	int n_lamps, i;
+
+	if (lc_clock == NULL) {
+		CC2K5_ERRNO(ENOSYS);
+		return -1;
+	}
+
+	/*
+	 * Sniffing only pays off if the host can sleep until the radio wakes
+	 * it, polling the CC2500 would wake it up as well.
+	 */
+	if (lc_wait_gdo == NULL)
+		lc_listen();
+	else if (lc_listen_wor(LEARN_PERIOD_US, LEARN_RX_TIME) != 0)
+		return -1;
 
 	n_lamps = 0;
+	start = lc_clock();
+	while ((elapsed = lc_clock() - start) < t * 1000000u) {
+		if (lc_wait_gdo != NULL
+				&& lc_wait_gdo(t * 1000000u - elapsed) < 0)
+			break;
+
+		if (!lc_receive(&rx))
+			continue;
 
-	for (; max > 0; max--) {
-		/* TODO */
+		for (i = 0; i < n_lamps; i++) {
+			if (memcmp(lamp[i].addr, rx.packet.address,
+					sizeof(lamp[i].addr)) == 0)
+				break;
+		}
+		if (i == max)
+			continue;
+		if (i == n_lamps) {
+			memcpy(lamp[i].addr, rx.packet.address,
+					sizeof(lamp[i].addr));
+			n_lamps++;
+		}
+
+		/* the lamp accepts only sequence numbers it has not seen */
+		lamp[i].seq = rx.packet.sequence_number + 1;
 	}
 
+	cc2k5_send_cmnd(SIDLE);
+	leave_wor();
+	cc2k5_send_cmnd(SFRX);
+
 	return n_lamps;
 }
 
 void lc_on(struct lc_lamp *lamp)
 {
-	memcpy(&(p_buf.address), &(lamp->addr), 9);
-	p_buf.command = LC_ON;
-	p_buf.sequence_number = lamp->seq;
+	memcpy(&(h_buf.packet.address), &(lamp->addr), 9);
+	h_buf.packet.sequence_number = lamp->seq;
 
-	cc2k5_send(&p_buf, sizeof(p_buf));
+	transmit(&h_buf, LC_ON);
 
 	lamp->seq++;
 }
 
 void lc_off(struct lc_lamp *lamp)
 {
-	memcpy(&(p_buf.address), &(lamp->addr), 9);
-	p_buf.command = LC_OFF;
-	p_buf.sequence_number = lamp->seq;
+	memcpy(&(h_buf.packet.address), &(lamp->addr), 9);
+	h_buf.packet.sequence_number = lamp->seq;
 
-	cc2k5_send(&p_buf, sizeof(p_buf));
+	transmit(&h_buf, LC_OFF);
 
 	lamp->seq++;
 }
 
 void lc_set_color(struct lc_lamp *lamp, struct color *new_color)
 {
-	memcpy(&(p_buf.address), &(lamp->addr), 9);
-	p_buf.command = LC_SET_COLOR;
-	p_buf.sequence_number = lamp->seq;
-	if (new_color != NULL) {
-		p_buf.color.hue = new_color->hue;
-		p_buf.color.saturation = new_color->saturation;
-		p_buf.color.value = new_color->value;
-	}
+	memcpy(&(h_buf.packet.address), &(lamp->addr), 9);
+	h_buf.packet.sequence_number = lamp->seq;
+	if (new_color != NULL)
+		h_buf.packet.color = *new_color;
 
-	cc2k5_send(&p_buf, sizeof(p_buf));
+	transmit(&h_buf, LC_SET_COLOR);
 
 	lamp->seq++;
 }
 
+void lc_handle_init(struct lc_handle *h, const struct lc_lamp *lamp)
+{
+	h->header = 0;
+	h->packet.preamble = 0x0E;
+	memcpy(&(h->packet.address), &(lamp->addr), 9);
+	h->packet.command = 0;
+	h->packet.sequence_number = lamp->seq;
+	h->packet.color = *lc_color;
+	h->state = LC_STATE_UNKNOWN;
+	h->color = *lc_color;
+	h->rssi = 0;
+	h->lqi = 0;
+	h->heard = 0;
+}
+
+int lc_handle_state(const struct lc_handle *h)
+{
+	return h->state;
+}
+
+int lc_handle_on(struct lc_handle *h)
+{
+	if (shows(h, &(h->packet.color))) {
+		lc_stats.suppressed++;
+		return 0;
+	}
+
+	transmit(h, LC_ON);
+
+	return 1;
+}
+
+int lc_handle_off(struct lc_handle *h)
+{
+	if (lc_suppress_threshold >= 0 && h->state == LC_STATE_OFF) {
+		lc_stats.suppressed++;
+		return 0;
+	}
+
+	transmit(h, LC_OFF);
+
+	return 1;
+}
+
+int lc_handle_set_color(struct lc_handle *h, const struct color *new_color)
+{
+	if (new_color == NULL)
+		new_color = &(h->packet.color);
+
+	if (shows(h, new_color)) {
+		lc_stats.suppressed++;
+		return 0;
+	}
+
+	lc_handle_send_color(h, new_color);
+
+	return 1;
+}
+
+void lc_handle_send_color(struct lc_handle *h, const struct color *color)
+{
+	h->packet.color = *color;
+
+	transmit(h, LC_SET_COLOR);
+}
+
+void lc_handle_repeat(struct lc_handle *h)
+{
+	/* nothing has been sent through the handle yet */
+	if (h->packet.command == 0)
+		return;
+
+	transmit(h, h->packet.command);
+}
+
+void lc_send_packet(const struct lc_packet *p)
+{
+	static struct lc_handle raw;
+
+	raw.packet = *p;
+
+	await_tx_end();
+
+	if (lc_tap != NULL)
+		tap_tx(p);
+
+	cc2k5_send_frame(&raw, sizeof(raw.packet));
+
+	lc_stats.sent++;
+}
+
+/*
+ * Puts the CC2500 back into receive mode, flushing the RX FIFO on the way.
+ */
+static void restart_rx(void)
+{
+	cc2k5_send_cmnd(SIDLE);
+	cc2k5_send_cmnd(SFRX);
+	cc2k5_send_cmnd(rx_strobe);
+}
+
+void lc_listen(void)
+{
+	cc2k5_send_cmnd(SIDLE);
+	leave_wor();
+	restart_rx();
+}
+
+int lc_listen_wor(uint32_t period_us, uint8_t rx_time)
+{
+	uint32_t event0;
+	uint8_t res;
+
+	/* EVENT0 counts periods of 750 / f_xosc, i.e. 750 / 26 us */
+	event0 = period_us / 750 * WOR_CLOCK_MHZ
+			+ period_us % 750 * WOR_CLOCK_MHZ / 750;
+	for (res = 0; event0 > 0xFFFF && res < 1; res++)
+		event0 >>= 5;
+
+	if (event0 == 0 || event0 > 0xFFFF || rx_time > RX_TIME) {
+		CC2K5_ERRNO(EINVAL);
+		return -1;
+	}
+
+	cc2k5_send_cmnd(SIDLE);
+	cc2k5_set_register(WOREVT1, (uint8_t)(event0 >> 8));
+	cc2k5_set_register(WOREVT0, (uint8_t)event0);
+	cc2k5_set_register(WORCTRL, EVENT1 | RC_CAL | res);
+	cc2k5_set_register(MCSM2, RX_TIME_QUAL | rx_time);
+
+	rx_strobe = SWOR;
+	restart_rx();
+
+	return 0;
+}
+
+int lc_receive(struct lc_rx *rx)
+{
+	uint8_t n, status[2];
+
+	/*
+	 * The RXBYTES register has to be read until the value is stable, see
+	 * the CC2500 errata.
+	 */
+	do {
+		n = cc2k5_get_status(RXBYTES);
+	} while (n != cc2k5_get_status(RXBYTES));
+
+	if (n & RXFIFO_OVERFLOW) {
+		restart_rx();
+		return 0;
+	}
+
+	if ((n & NUM_RXBYTES) < sizeof(rx->packet) + sizeof(status)) {
+		if (cc2k5_get_status(MARCSTATE) == MARCSTATE_IDLE)
+			cc2k5_send_cmnd(rx_strobe);
+		return 0;
+	}
+
+	cc2k5_read_fifo(&(rx->packet), sizeof(rx->packet));
+	cc2k5_read_fifo(status, sizeof(status));
+
+	if (rx->packet.preamble != sizeof(rx->packet) - 1
+			|| (status[1] & CRC_OK) == 0) {
+		restart_rx();
+		return 0;
+	}
+
+	rx->rssi = rssi_dbm(status[0]);
+	rx->lqi = status[1] & ~CRC_OK;
+
+	if (cc2k5_get_status(MARCSTATE) == MARCSTATE_IDLE)
+		cc2k5_send_cmnd(rx_strobe);
+
+	if (lc_tap != NULL)
+		lc_tap(LC_RX, rx);
+
+	return 1;
+}
+
+/*
+ * Polls MARCSTATE until the CC2500 is in `state`.
+ *
+ * \return	0 on success, -1 if it has not got there within `timeout_us`.
+ */
+static int await_state(uint8_t state, uint32_t timeout_us)
+{
+	uint32_t start;
+	unsigned int i;
+
+	start = lc_clock != NULL ? lc_clock() : 0;
+	for (i = 0; cc2k5_get_status(MARCSTATE) != state; i++) {
+		if (timed_out(start, i, timeout_us))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Waits for `us` microseconds on `lc_clock`.
+ */
+static void wait_us(uint32_t us)
+{
+	uint32_t start;
+
+	start = lc_clock();
+	while (lc_clock() - start < us)
+		;
+}
+
+int lc_sweep(struct lc_channel *ch, uint8_t first, unsigned int n)
+{
+	struct lc_channel *c;
+	uint8_t mcsm0, channr, channel, k;
+	unsigned int i;
+	int8_t rssi;
+	int ret;
+
+	if (lc_clock == NULL) {
+		CC2K5_ERRNO(ENOSYS);
+		return -1;
+	}
+
+	mcsm0 = cc2k5_get_register(MCSM0);
+	channr = cc2k5_get_register(CHANNR);
+
+	cc2k5_send_cmnd(SIDLE);
+	cc2k5_set_register(MCSM0, mcsm0 & ~FS_AUTOCAL);
+
+	ret = 0;
+	for (i = 0; i < n && first + i < 256; i++) {
+		c = &ch[i];
+		channel = (uint8_t)(first + i);
+
+		cc2k5_set_register(CHANNR, channel);
+
+		/* the calibration only holds for the channel it was made on */
+		if (c->calibrated && c->channel == channel) {
+			cc2k5_write_burst(FSCAL3, c->fscal, sizeof(c->fscal));
+		}
+		else {
+			cc2k5_send_cmnd(SCAL);
+			ret = await_state(MARCSTATE_IDLE, SWEEP_TIMEOUT_US);
+			if (ret != 0)
+				break;
+			cc2k5_read_burst(FSCAL3, c->fscal, sizeof(c->fscal));
+			c->channel = channel;
+			c->calibrated = 1;
+		}
+
+		cc2k5_send_cmnd(SRX);
+		ret = await_state(MARCSTATE_RX, SWEEP_TIMEOUT_US);
+		if (ret != 0)
+			break;
+		wait_us(RSSI_SETTLE_US);
+
+		c->rssi = INT8_MIN;
+		for (k = 0; k < SWEEP_SAMPLES; k++) {
+			rssi = rssi_dbm(cc2k5_get_status(RSSI));
+			if (rssi > c->rssi)
+				c->rssi = rssi;
+		}
+
+		cc2k5_send_cmnd(SIDLE);
+	}
+
+	if (ret != 0) {
+		cc2k5_send_cmnd(SIDLE);
+		CC2K5_ERRNO(ETIMEDOUT);
+	}
+
+	cc2k5_set_register(CHANNR, channr);
+	cc2k5_set_register(MCSM0, mcsm0);
+
+	return ret;
+}
+
+/*
+ * Advances the sequence number of `h` past `seq`, which another remote has
+ * used for the lamp.
+ */
+static void sync_seq(struct lc_handle *h, uint8_t seq)
+{
+	uint8_t ahead;
+
+	/* the answer of a lamp repeats our last one, i.e. is 0 ahead */
+	ahead = (uint8_t)(seq + 1 - h->packet.sequence_number);
+	if (ahead == 0 || (ahead >= 128 && h->heard > 0))
+		return;
+
+	h->packet.sequence_number = seq + 1;
+	lc_stats.synced++;
+}
+
+struct lc_handle *lc_observe(struct lc_handle *handles, unsigned int n_handles,
+		const struct lc_rx *rx)
+{
+	struct lc_handle *h;
+	unsigned int i;
+
+	for (i = 0; i < n_handles; i++) {
+		h = &handles[i];
+		if (memcmp(h->packet.address, rx->packet.address, 9) != 0)
+			continue;
+
+		mirror(h, rx->packet.command, &(rx->packet.color));
+		sync_seq(h, rx->packet.sequence_number);
+
+		/*
+		 * Exponential smoothing with a weight of 1/4 for the new
+		 * sample, the first one is taken as is.
+		 */
+		if (h->heard == 0) {
+			h->rssi = rx->rssi;
+			h->lqi = rx->lqi;
+		}
+		else {
+			h->rssi += (rx->rssi - h->rssi) / 4;
+			h->lqi += ((int)rx->lqi - h->lqi) / 4;
+		}
+		if (h->heard < 255)
+			h->heard++;
+
+		return h;
+	}
+
+	return NULL;
+}
+
+int lc_sync(struct lc_handle *handles, unsigned int n_handles,
+		uint32_t window)
+{
+	struct lc_rx rx;
+	uint32_t start;
+	int n;
+
+	if (lc_clock == NULL) {
+		CC2K5_ERRNO(ENOSYS);
+		return -1;
+	}
+
+	lc_listen();
+
+	n = 0;
+	start = lc_clock();
+	while (lc_clock() - start < window) {
+		if (lc_receive(&rx)
+				&& lc_observe(handles, n_handles, &rx) != NULL)
+			n++;
+	}
+
+	cc2k5_send_cmnd(SIDLE);
+	cc2k5_send_cmnd(SFRX);
+
+	return n;
+}
+
+uint8_t lc_handle_repetitions(const struct lc_handle *h)
+{
+	uint8_t n;
+
+	if (h->heard == 0)
+		return lc_default_repetitions;
+
+	n = 1;
+	if (h->rssi < RSSI_GOOD)
+		n += (RSSI_GOOD - h->rssi + RSSI_STEP - 1) / RSSI_STEP;
+	if (h->lqi > LQI_NOISY)
+		n++;
+
+	return n;
+}
+
+uint16_t lc_handle_spacing(const struct lc_handle *h)
+{
+	if (h->heard == 0 || h->rssi <= RSSI_POOR)
+		return 4 * LC_FRAME_PERIOD_US;
+
+	if (h->rssi < RSSI_GOOD)
+		return LC_FRAME_PERIOD_US;
+
+	return 0;
+}
+
+void lc_confirm_mode(int enable)
+{
+	uint8_t mcsm1;
+
+	mcsm1 = cc2k5_get_register(MCSM1) & ~TXOFF_MODE;
+	if (enable)
+		mcsm1 |= TXOFF_RX;
+
+	cc2k5_set_register(MCSM1, mcsm1);
+}
+
+/*
+ * Waits up to lc_confirm_window for the answer to the frame that has been sent
+ * through `h` at `start`, and stores the round-trip time in `rtt`.
+ */
+static int await_answer(const struct lc_handle *h, uint32_t start,
+		uint32_t *rtt)
+{
+	struct lc_rx rx;
+	uint8_t seq;
+	uint32_t t;
+
+	seq = h->packet.sequence_number - 1;
+
+	do {
+		t = lc_clock() - start;
+		if (!lc_receive(&rx))
+			continue;
+
+		if (rx.packet.sequence_number == seq
+				&& memcmp(rx.packet.address, h->packet.address,
+					sizeof(rx.packet.address)) == 0) {
+			*rtt = lc_clock() - start;
+			return 1;
+		}
+	} while (t < lc_confirm_window);
+
+	return 0;
+}
+
+int lc_handle_confirm(struct lc_handle *h, uint8_t attempts,
+		struct lc_delivery *d)
+{
+	struct lc_delivery buf;
+	uint32_t start;
+
+	if (lc_clock == NULL) {
+		CC2K5_ERRNO(ENOSYS);
+		return -1;
+	}
+
+	if (d == NULL)
+		d = &buf;
+
+	d->delivered = 0;
+	d->attempts = 1;
+	d->rtt = 0;
+
+	start = lc_clock();
+	for (;;) {
+		if (await_answer(h, start, &(d->rtt))) {
+			d->delivered = 1;
+			break;
+		}
+
+		if (d->attempts >= attempts)
+			break;
+
+		lc_handle_repeat(h);
+		start = lc_clock();
+		d->attempts++;
+	}
+
+	return d->delivered;
+}
+
+unsigned int lc_verify(struct lc_mismatch *m, unsigned int max, int repair)
+{
+	return cc2k5_verify(m, max, repair);
+}
+
 #ifdef __cplusplus
 }
 #endif	/* __cplusplus */
@@ -26,19 +26,20 @@
 extern "C" {
 #endif	/* __cplusplus */
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
  * Represents a color, which is defined by its hue, saturation and whiteness
  * (value).
  */
-#pragma pack(1)
+#pragma pack(push, 1)
 struct color {
 	/**
 	 * Hue is conventionally measured in degrees, but Philips expects only
 	 * an eight-bit octet, so the full color range is scaled to the interval
 	 * [0, 255]. The scaling is performed non-linear and a look-up table is
-	 * provided by the implementation.
+	 * provided by the implementation, see lc_hue_from_degrees().
 	 */
 	uint8_t hue;		/**< Color */
 	uint8_t saturation;	/**< Saturation */
@@ -47,11 +48,103 @@ struct color {
 
 extern struct color *lc_color;
 
+/**
+ * Converts an RGB color to the color representation of the lamps.
+ *
+ * The conversion uses integer arithmetic and look-up tables only.
+ */
+void lc_color_from_rgb(struct color *c, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * Converts `n` RGB colors at once.
+ *
+ * This is a scalar loop over the conversion of lc_color_from_rgb(), as its
+ * table look-ups keep compilers from vectorizing it.
+ *
+ * \param[out]	c	The `n` converted colors.
+ * \param[in]	rgb	`n` triplets of red, green and blue, as found in a
+ *			packed RGB24 frame.
+ * \param[in]	n	The number of colors to convert.
+ */
+void lc_colors_from_rgb(struct color *c, const uint8_t *rgb, unsigned int n);
+
+/**
+ * Converts a color temperature to the color representation of the lamps.
+ *
+ * \param[in]	kelvin	The color temperature, which will be clipped to the
+ *			range from 1000 K to 10000 K.
+ */
+void lc_color_from_kelvin(struct color *c, uint16_t kelvin);
+
+/**
+ * Estimates the perceptual difference of two colors on a scale from 0, which
+ * means they are indistinguishable, to 255.
+ *
+ * Hue differences are weighted by saturation and value, and saturation
+ * differences by value, as neither is visible in dark or unsaturated colors.
+ */
+uint8_t lc_color_delta(const struct color *a, const struct color *b);
+
+/**
+ * Maps a conventional hue angle to the non-linear hue scale of the lamps.
+ */
+uint8_t lc_hue_from_degrees(uint16_t degrees);
+
 struct lc_lamp {
 	uint8_t addr[9];	/**< The 9 byte address of the lamp. */
 	uint8_t seq;		/**< The sequence number of the lamp. */
 };
 
+/**
+ * This is the structure of the packets that are sent from the remote control to
+ * the lamp.
+ */
+struct lc_packet {
+	uint8_t preamble;		/**< This must always be 0x0E. */
+	uint8_t address[9];		/**< The address of the lamp. */
+	uint8_t command;		/**< The command to execute. */
+	uint8_t sequence_number;	/**< The packets sequence number. */
+	struct color color;		/**< The color of the lamp's light. */
+};
+
+/**
+ * The states that a lamp can be believed to be in.
+ */
+enum LC_STATES {
+	LC_STATE_UNKNOWN = 0,	/**< Nothing is known about the lamp. */
+	LC_STATE_OFF = 1,	/**< The lamp is turned off. */
+	LC_STATE_ON = 2		/**< The lamp is turned on. */
+};
+
+/**
+ * A lamp together with its pre-encoded frame.
+ *
+ * The frame is laid out exactly as it is written to the TX FIFO of the CC2500,
+ * i.e. one byte for the SPI header followed by the packet. Once the handle has
+ * been set up by lc_handle_init(), a command only patches the command, the
+ * sequence number and the color and hands the frame to the driver as is.
+ *
+ * The sequence number that will be used for the next command is kept in
+ * `packet.sequence_number`. lc_observe() advances it past the sequence numbers
+ * that other remotes use for the lamp, so that the lamp does not ignore the
+ * next command as one it has already seen.
+ *
+ * Besides the frame, the handle mirrors the state that the lamp is believed to
+ * be in. It is updated by every command sent through the handle and by the
+ * traffic of other remotes that is passed to lc_observe(). Commands that would
+ * not change this state are suppressed, see `lc_suppress_threshold`.
+ */
+struct lc_handle {
+	uint8_t header;		/**< Reserved for the SPI header byte. */
+	struct lc_packet packet;	/**< The packet as it is sent on air. */
+	uint8_t state;		/**< The believed state, one of `LC_STATES`. */
+	struct color color;	/**< The believed color, if the lamp is on. */
+	int8_t rssi;		/**< Smoothed RSSI of the lamp's traffic, dBm. */
+	uint8_t lqi;		/**< Smoothed LQI of the lamp's traffic. */
+	uint8_t heard;		/**< Packets heard, saturates at 255. */
+};
+#pragma pack(pop)
+
 /**
  * Initializes the Living Colors API.
  *
@@ -72,13 +165,48 @@ struct lc_lamp {
  */
 int lc_init(void);
 
+/**
+ * A register of the CC2500 whose value differs from the intended one, as found
+ * by lc_verify().
+ */
+struct lc_mismatch {
+	uint8_t addr;		/**< The register, 0x3E for the PA table. */
+	uint8_t index;		/**< The entry, if the register is the PA table. */
+	uint8_t expected;	/**< The value that has been written. */
+	uint8_t actual;		/**< The value read back. */
+};
+
+/**
+ * Checks that the configuration of the CC2500 is still the one that the
+ * library has written, e.g. to detect writes lost to a poor SPI connection or
+ * a reset of the chip.
+ *
+ * The configuration and the PA table are read back in two bursts, so this is
+ * cheap enough to be run periodically. The CC2500 is only put into IDLE if
+ * registers are actually repaired, and resumes receiving afterwards.
+ *
+ * \param[out]	m	The first `max` mismatches, may be NULL if `max` is
+ *			0.
+ * \param[in]	repair	Whether to rewrite the mismatching registers.
+ *
+ * \return	The number of registers that did not match.
+ */
+unsigned int lc_verify(struct lc_mismatch *m, unsigned int max, int repair);
+
 /**
  * Starts a learning phase of `t` seconds in which at most `max` addresses will
  * be learned and stored in `lamp`.
  *
  * The CC2500 will listen for ongoing communication and infer the addresses of
  * lamps from the traffic. To ensure that this works, the user has to use the
- * original remote to control the lamp during the learning phase.
+ * original remote to control the lamp during the learning phase. Along with the
+ * address, the sequence number following the last one heard is stored, so that
+ * the lamp accepts the next command.
+ *
+ * If `lc_wait_gdo` is set, the CC2500 only sniffs periodically, see
+ * lc_listen_wor(), and the host sleeps until a packet arrives. Otherwise the
+ * CC2500 listens continuously and is polled. The time is taken from
+ * `lc_clock`, which must be set.
  *
  * @param[in,out]	lamp	The addresses learned during the phase.
  * @param[in]		max	The maximum number of addresses to store in
@@ -86,7 +214,8 @@ int lc_init(void);
  * @param[in]		t	The number of seconds that the learning phase
  *				will last.
  *
- * @return	On success, the number of addresses that were learned.
+ * @return	On success, the number of addresses that were learned. If
+ *		`lc_clock` is not set, -1 with `errno` set to ENOSYS.
  */
 int lc_learn(struct lc_lamp *lamp, int max, uint8_t t);
 
@@ -112,6 +241,456 @@ void lc_off(struct lc_lamp *lamp);
  */
 void lc_set_color(struct lc_lamp *lamp, struct color *new_color);
 
+/**
+ * Pre-encodes the frame for `lamp` in `h`.
+ *
+ * The color of the frame is initialized with the one in lc_color.
+ */
+void lc_handle_init(struct lc_handle *h, const struct lc_lamp *lamp);
+
+/**
+ * Same as lc_on(), but sends the pre-encoded frame of `h`.
+ *
+ * The lamp is turned on with the color in `packet.color`, which is the one
+ * that has been set most recently through this handle.
+ *
+ * \return	1 if the frame has been sent, 0 if it has been suppressed.
+ */
+int lc_handle_on(struct lc_handle *h);
+
+/**
+ * Same as lc_off(), but sends the pre-encoded frame of `h`.
+ *
+ * \return	1 if the frame has been sent, 0 if it has been suppressed.
+ */
+int lc_handle_off(struct lc_handle *h);
+
+/**
+ * Same as lc_set_color(), but sends the pre-encoded frame of `h`.
+ *
+ * \param[in]	new_color	If this is NULL, the color that has been set
+ *				most recently through this handle will be used.
+ *
+ * \return	1 if the frame has been sent, 0 if it has been suppressed.
+ */
+int lc_handle_set_color(struct lc_handle *h, const struct color *new_color);
+
+/**
+ * Sends the last command of `h` once more, regardless of the mirrored state.
+ * Does nothing if no command has been sent through `h` yet.
+ *
+ * This is meant for repetitions, which make up for frames lost on air.
+ */
+void lc_handle_repeat(struct lc_handle *h);
+
+/**
+ * Returns the state that the lamp of `h` is believed to be in, i.e. one of
+ * `LC_STATES`.
+ */
+int lc_handle_state(const struct lc_handle *h);
+
+/**
+ * Color changes of a lamp whose perceptual difference, as computed by
+ * lc_color_delta(), does not exceed this threshold are suppressed. At the
+ * default of 0 only commands that would not change the state at all are
+ * suppressed, a negative value disables the suppression completely.
+ */
+extern int lc_suppress_threshold;
+
+/**
+ * Counters of the frames that have been sent resp. suppressed.
+ */
+struct lc_stats {
+	uint32_t sent;		/**< Frames that have been sent. */
+	uint32_t suppressed;	/**< Commands that have been suppressed. */
+	uint32_t synced;	/**< Sequence numbers taken from other remotes. */
+};
+
+extern struct lc_stats lc_stats;
+
+/**
+ * A packet received from the air together with its link quality.
+ */
+struct lc_rx {
+	struct lc_packet packet;	/**< The packet that has been received. */
+	int8_t rssi;		/**< The signal strength in dBm. */
+	uint8_t lqi;		/**< The link quality indicator, lower is better. */
+};
+
+enum LC_DIRECTIONS {
+	LC_TX = 0,	/**< A packet sent by the library. */
+	LC_RX = 1	/**< A packet received from the air. */
+};
+
+/**
+ * If set, this is called for every packet that is sent or received, e.g. to
+ * capture the traffic. For sent packets, `rssi` and `lqi` are 0.
+ *
+ * As it is called from within the command path, it must not block.
+ */
+extern void (*lc_tap)(int direction, const struct lc_rx *rx);
+
+/**
+ * Sends a packet as is, e.g. to replay captured traffic.
+ */
+void lc_send_packet(const struct lc_packet *p);
+
+/**
+ * Puts the CC2500 into receive mode to listen for the traffic of other remotes.
+ */
+void lc_listen(void);
+
+/**
+ * Puts the CC2500 into Wake-on-Radio mode, in which it sleeps and only listens
+ * for the first `rx_time` part of every `period_us` microseconds, unless it
+ * finds a sync word. This saves most of the power of lc_listen(), but only
+ * catches traffic that is repeated for at least a period.
+ *
+ * Every SPI access wakes the CC2500, so the host should not poll it but wait
+ * for GDO2, which is asserted on a sync word and deasserted at the end of the
+ * packet, and call lc_receive() then, which resumes the sniffing.
+ *
+ * \param[in]	period_us	The period, from 29 us to about 60 s.
+ * \param[in]	rx_time		The RX timeout as in MCSM2, 0 listens for 1/8
+ *				of the period and each step halves that.
+ *
+ * \return	Returns 0 on success, -1 otherwise with `errno` set to
+ *		EINVAL.
+ */
+int lc_listen_wor(uint32_t period_us, uint8_t rx_time);
+
+/**
+ * If set, this blocks until GDO2 of the CC2500 signals the end of a packet or
+ * `timeout_us` microseconds have passed, e.g. by waiting for an edge on the
+ * GPIO that GDO2 is wired to. It returns 1 for a packet, 0 on timeout and -1 on
+ * error, and lets lc_learn() sniff with lc_listen_wor().
+ */
+extern int (*lc_wait_gdo)(uint32_t timeout_us);
+
+/**
+ * Fetches a packet that has been received since lc_listen(), if there is one.
+ *
+ * Packets with a wrong length or CRC are dropped. The CC2500 is put back into
+ * receive mode if it has left it, e.g. after a reception or a transmission.
+ *
+ * \return	1 if a packet has been stored in `rx`, 0 otherwise.
+ */
+int lc_receive(struct lc_rx *rx);
+
+/**
+ * A channel of the CC2500 as measured by lc_sweep().
+ */
+struct lc_channel {
+	uint8_t fscal[3];	/**< FSCAL3 to FSCAL1 after calibration. */
+	uint8_t calibrated;	/**< Whether `fscal` is valid. */
+	uint8_t channel;	/**< The channel that `fscal` belongs to. */
+	int8_t rssi;		/**< The strongest signal measured, in dBm. */
+};
+
+/**
+ * Measures the signal strength on `n` consecutive channels, starting with
+ * `first`.
+ *
+ * The frequency synthesizer is calibrated for each channel on the first sweep
+ * only, the results are kept in `ch` and written back on later sweeps of the
+ * same channels, so that repeated sweeps only have to wait for the synthesizer
+ * and the RSSI to settle. Needs `lc_clock` to time the latter. While the
+ * original remote is in use, its channel stands out; without it, the sweep
+ * shows the interference on each channel.
+ *
+ * The CC2500 is left in the IDLE state on the configured channel.
+ *
+ * \param[in,out]	ch	One entry per channel, which must be zeroed
+ *				before the first sweep.
+ *
+ * \return	0 on success, -1 otherwise with `errno` set to ENOSYS if
+ *		`lc_clock` is not set, or to ETIMEDOUT if the CC2500 did not
+ *		calibrate or enter RX in time.
+ */
+int lc_sweep(struct lc_channel *ch, uint8_t first, unsigned int n);
+
+/**
+ * Updates the handle in `handles` whose lamp is addressed by the sniffed packet
+ * `rx`, i.e. its mirrored state, the estimate of its link quality and its
+ * sequence number.
+ *
+ * The sequence number of the handle is advanced past the one of the packet,
+ * unless the packet is up to 127 sequence numbers behind, i.e. stale. The
+ * first packet heard for a handle sets its sequence number in any case.
+ *
+ * \return	The handle that has been updated, or NULL if the packet does not
+ *		address any of the handles.
+ */
+struct lc_handle *lc_observe(struct lc_handle *handles, unsigned int n_handles,
+		const struct lc_rx *rx);
+
+/**
+ * Listens for `window` microseconds and passes every packet received to
+ * lc_observe(), so that the handles pick up the sequence numbers that other
+ * remotes currently use.
+ *
+ * This only finds something while the original remote is in use, but then
+ * saves the repetitions of commands that the lamps would have ignored.
+ *
+ * \return	The number of packets that addressed one of the handles, or -1 if
+ *		`lc_clock` is not set, with `errno` set to ENOSYS.
+ */
+int lc_sync(struct lc_handle *handles, unsigned int n_handles,
+		uint32_t window);
+
+/**
+ * The number of times a command is sent to a lamp whose link quality is not
+ * known, as no traffic has been heard for it yet.
+ */
+extern uint8_t lc_default_repetitions;
+
+/**
+ * Returns the number of times a command should be sent to the lamp of `h`,
+ * which grows as the link quality estimated by lc_observe() drops.
+ */
+uint8_t lc_handle_repetitions(const struct lc_handle *h);
+
+/**
+ * Returns the time in microseconds that should pass between repetitions of a
+ * command to the lamp of `h`.
+ *
+ * Frames for lamps with a poor link are spread out, so that a single burst of
+ * interference does not wipe out all of them.
+ */
+uint16_t lc_handle_spacing(const struct lc_handle *h);
+
+/**
+ * If set, this returns a free-running time in microseconds, which may wrap
+ * around. It is needed to time the receive windows of lc_handle_confirm().
+ */
+extern uint32_t (*lc_clock)(void);
+
+/**
+ * The time in microseconds that lc_handle_confirm() waits for the answer of a
+ * lamp after each frame.
+ */
+extern uint32_t lc_confirm_window;
+
+/**
+ * The outcome of a command that has been sent with lc_handle_confirm().
+ */
+struct lc_delivery {
+	uint8_t delivered;	/**< Whether the lamp has answered. */
+	uint8_t attempts;	/**< The number of frames that have been sent. */
+	uint32_t rtt;		/**< Microseconds from the last frame to the answer. */
+};
+
+/**
+ * Lets the CC2500 enter receive mode right after each transmission instead of
+ * going idle, so that it does not miss a quick answer of a lamp.
+ *
+ * \param[in]	enable	Whether to enter receive mode (1) or go idle (0)
+ *			after a transmission.
+ */
+void lc_confirm_mode(int enable);
+
+/**
+ * Waits for a lamp to answer the command that has just been sent through `h`
+ * and repeats the command if no answer arrives in time.
+ *
+ * An answer is a packet carrying the address of the lamp and the sequence
+ * number of the last frame. Each frame is given `lc_confirm_window`
+ * microseconds; other packets received in the meantime are dropped, apart from
+ * being passed to `lc_tap`.
+ *
+ * \param[in]	attempts	The maximum number of frames, including the
+ *				one that has already been sent.
+ * \param[out]	d		The outcome, may be NULL.
+ *
+ * \return	1 if the lamp has answered, 0 if it has not, -1 if `lc_clock`
+ *		is not set, with `errno` set to ENOSYS.
+ */
+int lc_handle_confirm(struct lc_handle *h, uint8_t attempts,
+		struct lc_delivery *d);
+
+/**
+ * A rectangular region of a frame, in pixels.
+ */
+struct lc_region {
+	uint16_t x;		/**< Left edge of the region. */
+	uint16_t y;		/**< Top edge of the region. */
+	uint16_t w;		/**< Width, 0 extends it to the right edge. */
+	uint16_t h;		/**< Height, 0 extends it to the bottom edge. */
+};
+
+/**
+ * A lamp that is driven by the average color of a region of the frames fed to
+ * an ambient light pipeline.
+ */
+struct lc_ambient_lamp {
+	struct lc_handle *handle;	/**< The lamp to drive. */
+	struct lc_region region;	/**< The region that the lamp mirrors. */
+	uint16_t avg[3];		/**< Smoothed average RGB, 8.8 fixed point. */
+};
+
+/**
+ * An ambient light pipeline, which turns RGB frames into lamp colors.
+ */
+struct lc_ambient {
+	struct lc_ambient_lamp *lamps;	/**< The lamps that are driven. */
+	unsigned int n_lamps;		/**< The number of lamps. */
+	uint16_t width;			/**< The width of the frames. */
+	uint16_t height;		/**< The height of the frames. */
+	/**
+	 * Only every `step`th pixel of every `step`th row is taken into the
+	 * average, i.e. the frames are downscaled by this factor.
+	 */
+	uint8_t step;
+	/**
+	 * The weight of a new frame in the temporal smoothing is 2^-smoothing,
+	 * so 0 disables the smoothing.
+	 */
+	uint8_t smoothing;
+};
+
+/**
+ * Sets up an ambient light pipeline for frames of `width` x `height` pixels.
+ *
+ * The handles and regions in `lamps` have to be set by the caller, the step is
+ * set to 1 and the smoothing to 2.
+ */
+void lc_ambient_init(struct lc_ambient *a, struct lc_ambient_lamp *lamps,
+		unsigned int n_lamps, uint16_t width, uint16_t height);
+
+/**
+ * Feeds a frame to the pipeline and sends the resulting colors to the lamps.
+ *
+ * A lamp is only sent a frame if its color changed perceptibly, see
+ * `lc_suppress_threshold`, so static scenes do not occupy the radio.
+ *
+ * \param[in]	frame	A packed RGB24 frame of the size given in
+ *			lc_ambient_init().
+ *
+ * \return	The number of frames that have been sent.
+ */
+unsigned int lc_ambient_feed(struct lc_ambient *a, const uint8_t *frame);
+
+/**
+ * The magic bytes at the beginning of a scene store.
+ */
+#define LC_SCENE_MAGIC		"LCS1"
+#define LC_SCENE_MAGIC_LEN	4
+
+/**
+ * The maximum number of lamps in a scene.
+ */
+#define LC_SCENE_MAX_ENTRIES	255
+
+/**
+ * The target state of a single lamp within a scene.
+ */
+struct lc_scene_entry {
+	uint8_t addr[9];	/**< The address of the lamp. */
+	uint8_t state;		/**< LC_STATE_ON or LC_STATE_OFF. */
+	struct color color;	/**< The color if the lamp is on. */
+};
+
+/**
+ * A named scene.
+ *
+ * A scene store is a contiguous block of memory, e.g. a memory-mapped file or a
+ * section in flash, that starts with `LC_SCENE_MAGIC` and is followed by any
+ * number of scenes, each immediately followed by the next.
+ */
+struct lc_scene {
+	char name[16];		/**< The name, not necessarily terminated. */
+	uint8_t n_entries;	/**< The number of lamps in the scene. */
+#ifdef __cplusplus
+	__extension__		/* flexible array members are not ISO C++ */
+#endif	/* __cplusplus */
+	struct lc_scene_entry entry[];	/**< The lamps of the scene. */
+};
+
+/**
+ * Looks up the scene called `name` in the scene store of `size` bytes at
+ * `store`.
+ *
+ * \return	The scene, or NULL if there is no such scene or the store is
+ *		malformed.
+ */
+const struct lc_scene *lc_scene_find(const void *store, size_t size,
+		const char *name);
+
+/**
+ * Activates a scene.
+ *
+ * Lamps are looked up in `handles` by their address, lamps without a handle
+ * are ignored. Lamps that are already in their target state, as far as it is
+ * known from the handle, are skipped. Each of the other lamps is sent its
+ * first frame before the first repetition is sent to any of them.
+ *
+ * \param[in]	repetitions	The number of frames sent to each lamp, if
+ *				this is 0 the number is chosen per lamp by
+ *				lc_handle_repetitions().
+ *
+ * \return	The number of frames that have been sent.
+ */
+unsigned int lc_scene_activate(const struct lc_scene *scene,
+		struct lc_handle *handles, unsigned int n_handles,
+		uint8_t repetitions);
+
+/**
+ * The time in microseconds that the radio is occupied by a single frame.
+ *
+ * A frame consists of 4 bytes preamble, the sync word sent twice, the 15 byte
+ * packet and 2 bytes CRC, which take 800 us at 250 kBaud. Together with the
+ * calibration of the synthesizer before each transmission and the SPI transfer,
+ * this allows for a frame every 2 ms.
+ *
+ * Every function that sends a frame first waits for the CC2500 to finish the
+ * previous one, so frames sent back to back are spaced by their air time.
+ */
+#define LC_FRAME_PERIOD_US	2000
+
+/**
+ * A smooth transition of the color of a lamp.
+ */
+struct lc_transition {
+	struct lc_handle *handle;	/**< The lamp to fade. */
+	struct color from;		/**< The color at the start. */
+	struct color to;		/**< The color at the end. */
+	uint32_t start;			/**< Start time in milliseconds. */
+	uint32_t duration;		/**< Duration in milliseconds. */
+	uint8_t active;			/**< Whether it is still running. */
+};
+
+/**
+ * Starts a transition of the lamp of `h` from one color to another.
+ *
+ * \param[in]	now		The current time in milliseconds, in the same
+ *				time base that is passed to
+ *				lc_transition_step().
+ * \param[in]	duration	The duration of the transition in
+ *				milliseconds.
+ */
+void lc_transition_start(struct lc_transition *t, struct lc_handle *h,
+		const struct color *from, const struct color *to,
+		uint32_t now, uint32_t duration);
+
+/**
+ * Sends the color that the transition should have reached at time `now`.
+ *
+ * The color is computed from the time alone, so steps are dropped if this is
+ * called late, instead of falling behind. Steps that do not change the color
+ * perceptibly are suppressed, see `lc_suppress_threshold`, except for the final
+ * one.
+ *
+ * \return	1 as long as the transition is running, 0 once the final color
+ *		has been sent.
+ */
+int lc_transition_step(struct lc_transition *t, uint32_t now);
+
+/**
+ * Returns the interval in microseconds in which `n_active` transitions can be
+ * stepped without saturating the radio.
+ */
+uint32_t lc_transition_interval(unsigned int n_active);
+
 enum SPI_TRANSFER_FLAGS {
 	SPI_NONE = 0,
 	/**
@@ -0,0 +1,192 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBLICOR_HPP_
+#define LIBLICOR_HPP_
+
+/*
+ * A header-only C++17 layer over the Living Colors API.
+ *
+ * The configuration of the CC2500 is checked and packed into burst writes at
+ * compile time, and the radio is driven through cc2k5::driver, so that the SPI
+ * backend is inlined into the command path. Handles, packets and colors are the
+ * structures of the C API, which may be used side by side.
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "liblicor.h"
+#include "radio_config.h"
+#include "cc2500/cc2500.hpp"
+
+namespace licor {
+
+/**
+ * The command codes of the packets, see `LIVING_COLORS_COMMANDS`.
+ */
+enum class command : std::uint8_t {
+	set_color = 3,
+	on = 5,
+	off = 7
+};
+
+/**
+ * The configuration of the CC2500 for the Living Colors lamps, as written by
+ * lc_init(). Both are generated from `LC_CONFIG`.
+ */
+#define LICOR_SETTING(addr, val)	{cc2k5::reg::addr, val},
+#define LICOR_COUNT(addr, val)		+ 1
+inline constexpr std::array<cc2k5::setting, 0 LC_CONFIG(LICOR_COUNT)>
+		settings = {{
+	LC_CONFIG(LICOR_SETTING)
+}};
+#undef LICOR_COUNT
+#undef LICOR_SETTING
+
+static_assert(cc2k5::valid(settings),
+		"registers must be configured in ascending order");
+
+/**
+ * The settings packed into burst writes.
+ */
+inline constexpr auto config =
+		cc2k5::pack<cc2k5::segments(settings)>(settings);
+
+static_assert(config.bytes.size() <= cc2k5::n_config + 8,
+		"the configuration is split into too many bursts");
+
+/**
+ * The output power, i.e. the first entry of the PA table.
+ */
+inline constexpr std::uint8_t pa_power = LC_PA_POWER;
+
+/**
+ * The radio, driven through the SPI backend `Spi`.
+ *
+ * In contrast to the C API, commands are never suppressed and neither counted
+ * in `lc_stats` nor passed to `lc_tap`; the mirrored state of the handle is
+ * kept up to date, though. lc_verify() only knows the configuration written by
+ * init() on cc2k5::c_spi, which drives the CC2500 of the C API.
+ */
+template <class Spi = cc2k5::c_spi>
+struct radio {
+	using cc = cc2k5::driver<Spi>;
+
+	/**
+	 * Same as lc_init().
+	 */
+	static int init()
+	{
+		if (cc::init() != 0)
+			return -1;
+
+		cc::configure(config);
+		cc::write_patable(pa_power);
+
+		cc::command(cc2k5::strobe::SIDLE);
+		cc::command(cc2k5::strobe::SIDLE);
+		cc::command(cc2k5::strobe::SPWD);
+		cc::command(cc2k5::strobe::SIDLE);
+
+		return 0;
+	}
+
+	/**
+	 * Sends the pre-encoded frame of `h` to turn the lamp on with the color
+	 * in its packet, like lc_handle_on() but unconditionally.
+	 */
+	static void on(lc_handle &h)
+	{
+		transmit(h, command::on);
+		h.state = LC_STATE_ON;
+		h.color = h.packet.color;
+	}
+
+	/**
+	 * Sends the pre-encoded frame of `h` to turn the lamp off, like
+	 * lc_handle_off() but unconditionally.
+	 */
+	static void off(lc_handle &h)
+	{
+		transmit(h, command::off);
+		h.state = LC_STATE_OFF;
+	}
+
+	/**
+	 * Sends the pre-encoded frame of `h` to set the color `c`, like
+	 * lc_handle_set_color() but unconditionally.
+	 */
+	static void set_color(lc_handle &h, const color &c)
+	{
+		h.packet.color = c;
+		transmit(h, command::set_color);
+		h.state = LC_STATE_ON;
+		h.color = c;
+	}
+
+	/**
+	 * Sends the last command of `h` once more, like lc_handle_repeat().
+	 * Does nothing if no command has been sent through `h` yet.
+	 */
+	static void repeat(lc_handle &h)
+	{
+		if (h.packet.command == 0)
+			return;
+
+		transmit(h, static_cast<command>(h.packet.command));
+	}
+
+private:
+	/**
+	 * How often the CC2500 is polled at most for the end of the previous
+	 * frame.
+	 */
+	static constexpr unsigned int max_polls = 4096;
+
+	/**
+	 * The values of MARCSTATE while a frame is on air.
+	 */
+	static constexpr std::uint8_t marcstate_tx = 0x13;
+	static constexpr std::uint8_t marcstate_tx_end = 0x14;
+
+	static void transmit(lc_handle &h, command c)
+	{
+		std::uint8_t state;
+
+		/* as in the C API, the previous frame has to be out first */
+		for (unsigned int i = 0; i < max_polls; i++) {
+			state = cc::read(cc2k5::status::MARCSTATE);
+			if (state != marcstate_tx && state != marcstate_tx_end
+					&& (cc::read(cc2k5::status::TXBYTES)
+						& NUM_TXBYTES) == 0)
+				break;
+		}
+
+		h.packet.command = static_cast<std::uint8_t>(c);
+		cc::send_frame(&h, sizeof(h.packet));
+		h.packet.sequence_number++;
+	}
+};
+
+}	/* namespace licor */
+
+#endif	/* LIBLICOR_HPP_ */
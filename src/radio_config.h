@@ -0,0 +1,87 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RADIO_CONFIG_H_
+#define RADIO_CONFIG_H_
+
+/*
+ * The configuration of the CC2500 for the Living Colors lamps, which the C
+ * library and the C++ layer both write.
+ *
+ * LC_CONFIG(X) expands X(register, value) for every configuration register
+ * from IOCFG2 to TEST0, in ascending order. Registers that are not used keep
+ * their reset values.
+ */
+#define LC_CONFIG(X) \
+	X(IOCFG2,	0x06) \
+	X(IOCFG1,	0x2E) \
+	X(IOCFG0,	0x01) \
+	X(FIFOTHR,	0x0D) \
+	X(SYNC1,	0xD3) \
+	X(SYNC0,	0x91) \
+	X(PKTLEN,	0xFF) \
+	X(PKTCTRL1,	0x04) \
+	X(PKTCTRL0,	0x45) \
+	X(ADDR,	0x00) \
+	X(CHANNR,	0x03) \
+	X(FSCTRL1,	0x09) \
+	X(FSCTRL0,	0x00) \
+	X(FREQ2,	0x5D) \
+	X(FREQ1,	0x93) \
+	X(FREQ0,	0xB1) \
+	X(MDMCFG4,	0x2D) \
+	X(MDMCFG3,	0x3B) \
+	X(MDMCFG2,	0x73) \
+	X(MDMCFG1,	0x22) \
+	X(MDMCFG0,	0xF8) \
+	X(DEVIATN,	0x00) \
+	X(MCSM2,	0x07) \
+	X(MCSM1,	0x30) \
+	X(MCSM0,	0x18) \
+	X(FOCCFG,	0x1D) \
+	X(BSCFG,	0x1C) \
+	X(AGCTRL2,	0xC7) \
+	X(AGCTRL1,	0x00) \
+	X(AGCTRL0,	0xB2) \
+	X(WOREVT1,	0x87) \
+	X(WOREVT0,	0x6B) \
+	X(WORCTRL,	0xF8) \
+	X(FREND1,	0xB6) \
+	X(FREND0,	0x10) \
+	X(FSCAL3,	0xEA) \
+	X(FSCAL2,	0x0A) \
+	X(FSCAL1,	0x00) \
+	X(FSCAL0,	0x11) \
+	X(RCCTRL1,	0x41) \
+	X(RCCTRL0,	0x00) \
+	X(FSTEST,	0x59) \
+	X(PTEST,	0x7F) \
+	X(AGCTEST,	0x3F) \
+	X(TEST2,	0x88) \
+	X(TEST1,	0x31) \
+	X(TEST0,	0x0B)
+
+/**
+ * The output power, i.e. the first entry of the PA table.
+ */
+#define LC_PA_POWER	0xFF
+
+#endif	/* RADIO_CONFIG_H_ */
@@ -0,0 +1,161 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif	/* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "liblicor.h"
+
+static size_t scene_size(const struct lc_scene *scene)
+{
+	return sizeof(*scene) + scene->n_entries * sizeof(scene->entry[0]);
+}
+
+const struct lc_scene *lc_scene_find(const void *store, size_t size,
+		const char *name)
+{
+	const uint8_t *p, *end;
+	const struct lc_scene *scene;
+
+	if (size < LC_SCENE_MAGIC_LEN
+			|| memcmp(store, LC_SCENE_MAGIC, LC_SCENE_MAGIC_LEN) != 0)
+		return NULL;
+
+	p = (const uint8_t *)store + LC_SCENE_MAGIC_LEN;
+	end = (const uint8_t *)store + size;
+
+	while ((size_t)(end - p) >= sizeof(*scene)) {
+		scene = (const struct lc_scene *)p;
+		if ((size_t)(end - p) < scene_size(scene))
+			break;
+
+		if (strncmp(scene->name, name, sizeof(scene->name)) == 0)
+			return scene;
+
+		p += scene_size(scene);
+	}
+
+	return NULL;
+}
+
+static int in_state(const struct lc_handle *h,
+		const struct lc_scene_entry *e)
+{
+	const struct color *c;
+
+	if (lc_handle_state(h) != e->state)
+		return 0;
+
+	if (e->state == LC_STATE_OFF)
+		return 1;
+
+	c = &(h->color);
+
+	return c->hue == e->color.hue && c->saturation == e->color.saturation
+			&& c->value == e->color.value;
+}
+
+static struct lc_handle *find_handle(struct lc_handle *handles,
+		unsigned int n_handles, const uint8_t addr[9])
+{
+	unsigned int k;
+
+	for (k = 0; k < n_handles; k++) {
+		if (memcmp(handles[k].packet.address, addr, 9) == 0)
+			return &handles[k];
+	}
+
+	return NULL;
+}
+
+unsigned int lc_scene_activate(const struct lc_scene *scene,
+		struct lc_handle *handles, unsigned int n_handles,
+		uint8_t repetitions)
+{
+	uint8_t pending[(LC_SCENE_MAX_ENTRIES + 7) / 8];
+	const struct lc_scene_entry *e;
+	struct lc_handle *h;
+	unsigned int i, n, r, sent;
+	int ok;
+
+	/*
+	 * First mark the lamps that are not yet in their target state, as the
+	 * handles will already be in it after the first round.
+	 */
+	memset(pending, 0, sizeof(pending));
+	n = 0;
+	for (i = 0; i < scene->n_entries; i++) {
+		e = &(scene->entry[i]);
+		h = find_handle(handles, n_handles, e->addr);
+		if (h == NULL || in_state(h, e))
+			continue;
+
+		pending[i / 8] |= 1u << (i % 8);
+		n++;
+	}
+
+	/*
+	 * Every lamp gets its first frame before any lamp gets a repetition,
+	 * which minimizes the time until all lamps have received a command.
+	 */
+	sent = 0;
+	for (r = 0; n > 0; r++) {
+		for (i = 0; i < scene->n_entries; i++) {
+			if ((pending[i / 8] & (1u << (i % 8))) == 0)
+				continue;
+
+			e = &(scene->entry[i]);
+			h = find_handle(handles, n_handles, e->addr);
+
+			if (r > 0) {
+				lc_handle_repeat(h);
+				ok = 1;
+			}
+			else if (e->state == LC_STATE_OFF) {
+				ok = lc_handle_off(h);
+			}
+			else {
+				h->packet.color = e->color;
+				ok = lc_handle_on(h);
+			}
+
+			if (ok)
+				sent++;
+
+			if (!ok || r + 1 >= (repetitions > 0 ? repetitions
+					: lc_handle_repetitions(h))) {
+				pending[i / 8] &= ~(1u << (i % 8));
+				n--;
+			}
+		}
+	}
+
+	return sent;
+}
+
+#ifdef __cplusplus
+}
+#endif	/* __cplusplus */
@@ -0,0 +1,137 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif	/* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "internal.h"
+#include "liblicor.h"
+
+/*
+ * The interval in which a single transition is stepped, if the radio allows.
+ * Faster updates are not perceivable anyway.
+ */
+#define LC_TRANSITION_MIN_INTERVAL_US	20000
+
+static uint8_t isqrt(uint16_t x)
+{
+	uint16_t r, bit;
+
+	r = 0;
+	for (bit = 1u << 14; bit > x; bit >>= 2)
+		;
+
+	for (; bit != 0; bit >>= 2) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		}
+		else {
+			r >>= 1;
+		}
+	}
+
+	return (uint8_t)r;
+}
+
+static uint8_t lerp(uint8_t a, uint8_t b, uint16_t f)
+{
+	return (uint8_t)(a + (((int32_t)b - a) * f >> 8));
+}
+
+/*
+ * Interpolates between `from` and `to`, where `f` runs from 0 to 256.
+ *
+ * The hue takes the shorter way around the color wheel and the value is
+ * interpolated on a square root scale, which approximates the perceived
+ * brightness, so that fades do not appear to rush through the dark end.
+ */
+static void interpolate(struct color *c, const struct color *from,
+		const struct color *to, uint16_t f)
+{
+	uint8_t h0, h1, v;
+	int16_t dh;
+
+	h0 = from->saturation == 0 ? to->hue : from->hue;
+	h1 = to->saturation == 0 ? h0 : to->hue;
+
+	dh = (int8_t)(uint8_t)(h1 - h0);
+	c->hue = (uint8_t)(h0 + (dh * (int32_t)f >> 8));
+	c->saturation = lerp(from->saturation, to->saturation, f);
+
+	v = lerp(isqrt(255u * from->value), isqrt(255u * to->value), f);
+	c->value = (uint8_t)(((uint16_t)v * v + 127) / 255);
+}
+
+void lc_transition_start(struct lc_transition *t, struct lc_handle *h,
+		const struct color *from, const struct color *to,
+		uint32_t now, uint32_t duration)
+{
+	t->handle = h;
+	t->from = *from;
+	t->to = *to;
+	t->start = now;
+	t->duration = duration;
+	t->active = 1;
+}
+
+int lc_transition_step(struct lc_transition *t, uint32_t now)
+{
+	struct color c;
+	uint32_t elapsed;
+
+	if (!t->active)
+		return 0;
+
+	elapsed = now - t->start;
+	if (elapsed >= t->duration) {
+		/* the lamp has to end up at the target, however close it is */
+		lc_handle_send_color(t->handle, &(t->to));
+		t->active = 0;
+
+		return 0;
+	}
+
+	interpolate(&c, &(t->from), &(t->to),
+			(uint16_t)(((uint64_t)elapsed << 8) / t->duration));
+	lc_handle_set_color(t->handle, &c);
+
+	return 1;
+}
+
+uint32_t lc_transition_interval(unsigned int n_active)
+{
+	uint32_t interval;
+
+	interval = (uint32_t)LC_FRAME_PERIOD_US * n_active;
+	if (interval < LC_TRANSITION_MIN_INTERVAL_US)
+		interval = LC_TRANSITION_MIN_INTERVAL_US;
+
+	return interval;
+}
+
+#ifdef __cplusplus
+}
+#endif	/* __cplusplus */
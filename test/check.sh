@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Runs the command-line interface in $1 against the emulated CC2500, the lamp
+# farm and the fake soft SPI, and checks what it reports.
+
+set -u
+
+LICOR=$1
+ADDR=01:02:03:04:05:06:07:08:09
+FAILURES=0
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# expect <description> <extended regex> <command> [<argument>...]
+#
+# Runs the command, which has to succeed and to print a line matching the
+# regex.
+expect() {
+	desc=$1
+	pattern=$2
+	shift 2
+
+	"$@" > "$TMP/out" 2>&1
+	status=$?
+
+	if [ $status -ne 0 ]; then
+		echo "FAIL $desc: exit status $status"
+		sed 's/^/	/' "$TMP/out"
+		FAILURES=$((FAILURES + 1))
+	elif ! grep -Eq -- "$pattern" "$TMP/out"; then
+		echo "FAIL $desc: no line matches \`$pattern'"
+		sed 's/^/	/' "$TMP/out"
+		FAILURES=$((FAILURES + 1))
+	else
+		echo "ok   $desc"
+	fi
+}
+
+# fails <description> <command> [<argument>...]
+#
+# Runs the command, which has to fail.
+fails() {
+	desc=$1
+	shift
+
+	if "$@" > "$TMP/out" 2>&1; then
+		echo "FAIL $desc: exit status 0"
+		FAILURES=$((FAILURES + 1))
+	else
+		echo "ok   $desc"
+	fi
+}
+
+expect "on" "^1 frames sent" \
+	"$LICOR" -v -d emu -a $ADDR on 10,20,30
+expect "off with repetitions" "^3 frames sent" \
+	"$LICOR" -v -r 3 -d emu -a $ADDR off
+expect "set" "^1 frames sent" \
+	"$LICOR" -v -d emu -a $ADDR set 40,50,60
+
+expect "confirm" "^delivered after 1 frames" \
+	"$LICOR" -v -C 3000 -d emu -a $ADDR on 1,2,3
+
+expect "sweep" "^strongest signal on channel 0," \
+	"$LICOR" -d emu sweep 0 4
+
+expect "farm" "^40 updates, 40 delivered, 0 missed" \
+	"$LICOR" -d farm:8 -r 2 farm 5
+
+printf '%s\n' "$ADDR set 1,2,3" "$ADDR set 1,2,3 @5" > "$TMP/same"
+expect "batch suppresses a repeated color" "^1 frames sent, 1 suppressed" \
+	"$LICOR" -v -t -d emu batch "$TMP/same"
+
+# the repetitions of a lamp go out once per round, however many commands
+printf '%s\n' "$ADDR on 1,2,3" "$ADDR off" \
+	"01:02:03:04:05:06:07:08:0a on 1,2,3" > "$TMP/two"
+expect "batch repetitions" "^3 commands for 2 lamps, 7 frames" \
+	"$LICOR" -v -r 3 -d emu batch "$TMP/two"
+
+expect "soft SPI transfers" "16\.[01] line writes and 8\.0 reads per byte" \
+	"$LICOR" -d gpio:fake bench 100
+
+fails "replay of a missing capture" \
+	"$LICOR" -d emu replay "$TMP/missing"
+
+if [ $FAILURES -ne 0 ]; then
+	echo "$FAILURES checks failed"
+	exit 1
+fi
@@ -0,0 +1,123 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Builds the C++ layer against the C library: the radio is brought up on the
+ * emulated CC2500 through the C driver's backend, after which lc_verify() has
+ * to know the configuration, and a frame is sent through a backend of its own.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <liblicor.hpp>
+
+extern "C" {
+#include "emu.h"
+
+int spi_init(void)
+{
+	return emu_init();
+}
+
+int spi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	return emu_transfer(tx_buf, rx_buf, n_bytes);
+}
+}
+
+static int failures;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", \
+					__FILE__, __LINE__, #cond);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+/*
+ * A backend that is always ready and counts the bytes of the strobes.
+ */
+struct counting_spi {
+	static unsigned int n_stx;
+
+	static int init()
+	{
+		return 0;
+	}
+
+	static int transfer(const std::uint8_t *tx, std::uint8_t *rx,
+			std::uint8_t n_bytes)
+	{
+		if (n_bytes == 1
+				&& tx[0] == static_cast<std::uint8_t>(
+					cc2k5::strobe::STX))
+			n_stx++;
+
+		if (rx != nullptr) {
+			std::memset(rx, 0, n_bytes);
+			/* PARTNUM, and a transmission that is over */
+			if (n_bytes > 1)
+				rx[1] = cc2k5::partnum;
+		}
+
+		return 0;
+	}
+};
+
+unsigned int counting_spi::n_stx;
+
+int main()
+{
+	using radio = licor::radio<>;
+	const lc_lamp lamp = {{1, 2, 3, 4, 5, 6, 7, 8, 9}, 0};
+	lc_mismatch m[4];
+	lc_handle h;
+	unsigned long frames;
+	std::uint8_t tx[2] = {IOCFG0, 0x2E};
+
+	CHECK(radio::init() == 0);
+	CHECK(lc_verify(m, 4, 0) == 0);
+
+	/* a register changed behind the back of both drivers */
+	emu_transfer(tx, nullptr, 2);
+	CHECK(lc_verify(m, 4, 1) == 1);
+	CHECK(m[0].addr == IOCFG0 && m[0].actual == 0x2E);
+	CHECK(lc_verify(m, 4, 0) == 0);
+
+	lc_handle_init(&h, &lamp);
+	frames = emu_frames;
+	radio::on(h);
+	CHECK(emu_frames == frames + 1);
+	CHECK(h.state == LC_STATE_ON);
+
+	CHECK(licor::radio<counting_spi>::init() == 0);
+	licor::radio<counting_spi>::off(h);
+	CHECK(counting_spi::n_stx == 1);
+	CHECK(h.state == LC_STATE_OFF);
+
+	if (failures == 0)
+		std::puts("hpp: ok");
+
+	return failures != 0;
+}
@@ -0,0 +1,193 @@
+/* Copyright (c) 2014 Darius Kellermann <darius.kellermann@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Learns two lamps from the frames of their remotes on the emulated CC2500,
+ * once polling and once sniffing with Wake-on-Radio, and checks that the
+ * Wake-on-Radio settings do not outlive the learning.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <liblicor.h>
+#include <cc2500/cc2500.h>
+#include <cc2500/cc2500_regmap.h>
+
+#include "emu.h"
+
+#define LEARN_SECONDS	1
+
+static const struct lc_lamp remote[2] = {
+	{{0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99}, 41},
+	{{0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09}, 200}
+};
+
+/*
+ * The frames of the remotes, as they went on air.
+ */
+static uint8_t frame[2][64];
+static uint8_t n_frame[2];
+static uint8_t next_seq[2];	/**< The numbers after the frames. */
+static unsigned int n_captured;
+
+static uint32_t now_us;
+static unsigned int n_injected;
+static uint8_t mcsm2_wor;
+
+static int failures;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+					__FILE__, __LINE__, #cond);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+int spi_init(void)
+{
+	return emu_init();
+}
+
+int spi_transfer(void *tx_buf, void *rx_buf, uint8_t n_bytes)
+{
+	return emu_transfer(tx_buf, rx_buf, n_bytes);
+}
+
+static void capture(const uint8_t *f, uint8_t n_bytes)
+{
+	memcpy(frame[n_captured], f, n_bytes);
+	n_frame[n_captured] = n_bytes;
+	n_captured++;
+}
+
+/*
+ * The remotes take turns in sending their frame.
+ */
+static void inject(void)
+{
+	emu_inject(frame[n_injected % 2], n_frame[n_injected % 2], 0xE0,
+			0x80 | 0x10);
+	n_injected++;
+}
+
+/*
+ * A clock that advances by a millisecond per call, with a frame every 50 ms.
+ */
+static uint32_t fake_clock(void)
+{
+	now_us += 1000;
+	if (now_us % 50000 == 0)
+		inject();
+
+	return now_us;
+}
+
+/*
+ * GDO2 is asserted 100 ms into the wait, by the next frame.
+ */
+static int fake_wait_gdo(uint32_t timeout_us)
+{
+	mcsm2_wor = cc2k5_get_register(MCSM2);
+
+	if (timeout_us < 100000)
+		return 0;
+
+	now_us += 100000;
+	inject();
+
+	return 1;
+}
+
+static uint32_t quiet_clock(void)
+{
+	return now_us += 1000;
+}
+
+static void check_learned(const struct lc_lamp *lamp, int n)
+{
+	int i, k;
+
+	CHECK(n == 2);
+
+	for (i = 0; i < n && i < 2; i++) {
+		for (k = 0; k < 2; k++) {
+			if (memcmp(lamp[i].addr, remote[k].addr, 9) == 0)
+				break;
+		}
+		CHECK(k < 2);
+		if (k < 2)
+			CHECK(lamp[i].seq == next_seq[k]);
+	}
+}
+
+int main(void)
+{
+	struct lc_handle h;
+	struct lc_lamp lamp[4];
+	uint8_t mcsm2, worctrl;
+	int i, n;
+
+	if (lc_init() != 0) {
+		perror("lc_init");
+		return 1;
+	}
+
+	mcsm2 = cc2k5_get_register(MCSM2);
+	worctrl = cc2k5_get_register(WORCTRL);
+
+	emu_on_tx = capture;
+	for (i = 0; i < 2; i++) {
+		lc_handle_init(&h, &remote[i]);
+		lc_handle_set_color(&h, NULL);
+		next_seq[i] = h.packet.sequence_number;
+	}
+	emu_on_tx = NULL;
+	CHECK(n_captured == 2);
+
+	lc_clock = fake_clock;
+	n = lc_learn(lamp, 4, LEARN_SECONDS);
+	check_learned(lamp, n);
+	CHECK(n_injected > 2);
+
+	lc_clock = quiet_clock;
+	lc_wait_gdo = fake_wait_gdo;
+	n_injected = 0;
+	n = lc_learn(lamp, 4, LEARN_SECONDS);
+	check_learned(lamp, n);
+	CHECK(n_injected > 2);
+
+	/* sniffing programs an RX timeout, which must not stick */
+	CHECK(mcsm2_wor != mcsm2);
+	CHECK(cc2k5_get_register(MCSM2) == mcsm2);
+	CHECK(cc2k5_get_register(WORCTRL) == worctrl);
+
+	lc_wait_gdo = NULL;
+	lc_clock = NULL;
+	CHECK(lc_learn(lamp, 4, LEARN_SECONDS) == -1);
+
+	if (failures == 0)
+		puts("learn: ok");
+
+	return failures != 0;
+}